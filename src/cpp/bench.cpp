@@ -0,0 +1,546 @@
+#ifdef BENCH_CPP
+
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <typeinfo>
+#include <typeindex>
+#include <unordered_set>
+#include <iostream>
+
+#include "../hpp/das/prelude.hpp"
+#include "../hpp/das/string.hpp"
+#include "../hpp/das/hash.hpp"
+#include "../hpp/das/name.hpp"
+#include "../hpp/das/castable.hpp"
+#include "../hpp/das/castable_pool.hpp"
+#include "../hpp/das/addressable.hpp"
+#include "../hpp/das/address.hpp"
+#include "../hpp/das/address_tree.hpp"
+#include "../hpp/das/property.hpp"
+#include "../hpp/das/property_store.hpp"
+#include "../hpp/das/eventable.hpp"
+#include "../hpp/das/eventable_concurrent.hpp"
+
+namespace bench
+{
+    // Results are folded into the sink so that the optimizer cannot discard the work measured.
+    volatile std::size_t sink;
+
+    // The filter on the names of the benchmarks to run, if any.
+    std::string filter;
+
+    // Run a benchmark, doubling its iterations until it runs long enough to time, then write its
+    // result as a CSV row. The benchmark is given how many iterations to run.
+    template<typename F>
+    void run(const std::string& name, std::size_t parameter, const F& benchmark)
+    {
+        if (name.find(filter) == std::string::npos) return;
+        for (std::size_t iterations = 1;; iterations *= 2)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            benchmark(iterations);
+            const auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            if (elapsed >= 50000000.0 || iterations >= (std::size_t(1) << 30))
+            {
+                std::cout << name << ',' << parameter << ',' << iterations << ',' << elapsed / static_cast<double>(iterations) << std::endl;
+                return;
+            }
+        }
+    }
+
+    // A trivial program type to benchmark the eventable program mixin.
+    class event_program : public das::eventable<event_program>
+    {
+    protected:
+
+        ENABLE_CAST(event_program, das::eventable<event_program>);
+    };
+
+    // A trivial program type to benchmark the eventable_concurrent program mixin.
+    class concurrent_program : public das::eventable_concurrent<concurrent_program>
+    {
+    protected:
+
+        ENABLE_CAST(concurrent_program, das::eventable_concurrent<concurrent_program>);
+    };
+
+    // A castable type at the given depth of inheritance from castable.
+    template<int N>
+    class castable_level : public castable_level<N - 1>
+    {
+    protected:
+
+        ENABLE_CAST(castable_level<N>, castable_level<N - 1>);
+    };
+
+    template<>
+    class castable_level<0> : public das::castable
+    {
+    protected:
+
+        ENABLE_CAST(castable_level<0>, das::castable);
+    };
+
+    // A castable type unrelated to any castable_level, to which casts always fail.
+    class castable_other : public das::castable
+    {
+    protected:
+
+        ENABLE_CAST(castable_other, das::castable);
+    };
+
+    // The former castable mechanism, which walks the inheritance chain with a virtual call and a
+    // type_index comparison per level, kept to benchmark against.
+    class chain_castable
+    {
+    public:
+
+        virtual void* try_cast(std::type_index type_index)
+        {
+            return type_index == std::type_index(typeid(chain_castable)) ? this : nullptr;
+        }
+
+        virtual ~chain_castable() = default;
+    };
+
+    template<int N>
+    class chain_castable_level : public chain_castable_level<N - 1>
+    {
+    public:
+
+        void* try_cast(std::type_index type_index) override
+        {
+            return type_index == std::type_index(typeid(chain_castable_level<N>)) ? this : chain_castable_level<N - 1>::try_cast(type_index);
+        }
+    };
+
+    template<>
+    class chain_castable_level<0> : public chain_castable
+    {
+    public:
+
+        void* try_cast(std::type_index type_index) override
+        {
+            return type_index == std::type_index(typeid(chain_castable_level<0>)) ? this : chain_castable::try_cast(type_index);
+        }
+    };
+
+    class chain_castable_other : public chain_castable { };
+
+    template<typename T>
+    void cast_benchmark(const std::string& name, int depth, const T& cast)
+    {
+        run(name, static_cast<std::size_t>(depth), [&](std::size_t iterations)
+        {
+            for (std::size_t i = 0; i < iterations; ++i)
+                sink = sink + reinterpret_cast<std::uintptr_t>(cast());
+        });
+    }
+
+    // Measure casting an object at the given depth to the root of its castable chain, which is the
+    // worst case for the chain walk, and to an unrelated type, which is a cast that fails, with
+    // try_cast, the former chain walk, and dynamic_cast.
+    template<int N>
+    void try_cast_depth()
+    {
+        castable_level<N> level{};
+        das::castable* castable = &level;
+        cast_benchmark("try_cast_depth", N, [&]() { return das::try_cast<castable_level<0>>(*castable); });
+        cast_benchmark("try_cast_miss_depth", N, [&]() { return das::try_cast<castable_other>(*castable); });
+
+        chain_castable_level<N> chain_level{};
+        chain_castable* chain_castable = &chain_level;
+        cast_benchmark("chain_cast_depth", N, [&]() { return chain_castable->try_cast(std::type_index(typeid(chain_castable_level<0>))); });
+        cast_benchmark("chain_cast_miss_depth", N, [&]() { return chain_castable->try_cast(std::type_index(typeid(chain_castable_other))); });
+
+        cast_benchmark("dynamic_cast_depth", N, [&]() { return dynamic_cast<castable_level<0>*>(castable); });
+        cast_benchmark("dynamic_cast_miss_depth", N, [&]() { return dynamic_cast<castable_other*>(castable); });
+    }
+
+    // A simulant to iterate among others of an unrelated type.
+    class simulant : public das::castable
+    {
+    public:
+
+        std::int64_t age;
+
+        simulant() : age() { }
+
+    protected:
+
+        ENABLE_CAST(simulant, das::castable);
+    };
+
+    // Measure visiting the simulants among the given number of objects, half of which are
+    // simulants, both as individually allocated castables visited with try_cast, and in a
+    // castable pool visited with for_each, in nanoseconds per object.
+    inline void castable_iteration(std::size_t object_count)
+    {
+        std::vector<std::unique_ptr<das::castable>> objects{};
+        das::castable_pool pool;
+        for (std::size_t i = 0; i < object_count; ++i)
+        {
+            if (i % 2 == 0)
+            {
+                objects.push_back(std::make_unique<simulant>());
+                das::add_castable<simulant>(pool);
+            }
+            else
+            {
+                objects.push_back(std::make_unique<castable_other>());
+                das::add_castable<castable_other>(pool);
+            }
+        }
+        run("castable_vector_try_cast", object_count, [&](std::size_t iterations)
+        {
+            for (std::size_t i = 0; i < iterations; i += object_count)
+                for (auto& object : objects)
+                    if (auto* simulant_opt = das::try_cast<simulant>(*object))
+                        ++simulant_opt->age;
+        });
+        run("castable_pool_for_each", object_count, [&](std::size_t iterations)
+        {
+            for (std::size_t i = 0; i < iterations; i += object_count)
+                das::for_each<simulant>(pool, [](simulant& simulant) { ++simulant.age; });
+        });
+    }
+
+    inline std::string make_address_str(std::size_t depth)
+    {
+        std::vector<std::string> names{};
+        for (std::size_t i = 0; i < depth; ++i) names.push_back("segment" + std::to_string(i));
+        return das::join_strings(names, '/');
+    }
+
+    inline void publish_event_fan_out(std::size_t subscriber_count)
+    {
+        event_program program;
+        const auto event_address = das::address("bench/event");
+        const auto participant = std::make_shared<das::addressable>(das::name_t("participant"));
+        for (std::size_t i = 0; i < subscriber_count; ++i)
+        {
+            das::subscribe_event<std::int64_t, event_program>(program, event_address, participant, [](const auto& event, auto&)
+            {
+                sink = sink + static_cast<std::size_t>(event.data);
+                return true;
+            });
+        }
+        run("publish_event_fan_out", subscriber_count, [&](std::size_t iterations)
+        {
+            for (std::size_t i = 0; i < iterations; ++i)
+                das::publish_event(program, static_cast<std::int64_t>(i), event_address, participant);
+        });
+    }
+
+    inline void subscribe_unsubscribe_churn(std::size_t subscription_count)
+    {
+        event_program program;
+        const auto event_address = das::address("bench/event");
+        const auto participant = std::make_shared<das::addressable>(das::name_t("participant"));
+        const auto handler = [](const auto&, auto&) { return true; };
+        for (std::size_t i = 0; i < subscription_count; ++i)
+            das::subscribe_event<std::int64_t, event_program>(program, event_address, participant, handler);
+        run("subscribe_unsubscribe_churn", subscription_count, [&](std::size_t iterations)
+        {
+            for (std::size_t i = 0; i < iterations; ++i)
+            {
+                const auto unsubscribe = das::subscribe_event<std::int64_t, event_program>(program, event_address, participant, handler);
+                unsubscribe(program);
+            }
+        });
+    }
+
+    inline void address_from_string(std::size_t depth)
+    {
+        const auto address_str = make_address_str(depth);
+        run("address_from_string", depth, [&](std::size_t iterations)
+        {
+            for (std::size_t i = 0; i < iterations; ++i)
+                sink = sink + static_cast<std::size_t>(das::address(address_str));
+        });
+    }
+
+    inline void address_from_literal()
+    {
+        run("address_from_literal", 4, [&](std::size_t iterations)
+        {
+            for (std::size_t i = 0; i < iterations; ++i)
+                sink = sink + static_cast<std::size_t>(DAS_ADDRESS("segment0/segment1/segment2/segment3"));
+        });
+    }
+
+    // Measure appending a name to a parent address of the given depth, both as a new address and
+    // as a child node of an address tree.
+    inline void address_append(std::size_t depth)
+    {
+        const auto parent = das::address(make_address_str(depth));
+        const auto child = das::address("child");
+        run("address_concat", depth, [&](std::size_t iterations)
+        {
+            for (std::size_t i = 0; i < iterations; ++i)
+                sink = sink + static_cast<std::size_t>(parent + child);
+        });
+
+        das::address_tree tree;
+        const auto& parent_node = das::get_node(tree, parent);
+        const auto child_name = das::name_t("child");
+        run("address_tree_child", depth, [&](std::size_t iterations)
+        {
+            for (std::size_t i = 0; i < iterations; ++i)
+                sink = sink + das::get_node_hash(das::get_child_node(tree, parent_node, child_name));
+        });
+    }
+
+    inline void name_hash(std::size_t length)
+    {
+        const auto name_str = std::string(length, 'n');
+        run("name_hash", length, [&](std::size_t iterations)
+        {
+            for (std::size_t i = 0; i < iterations; ++i)
+                sink = sink + das::get_hash(das::name_t(name_str));
+        });
+    }
+
+    inline void name_equality(std::size_t length)
+    {
+        const auto left = das::name_t(std::string(length, 'n'));
+        const auto right = das::name_t(std::string(length, 'n'));
+        run("name_equality", length, [&](std::size_t iterations)
+        {
+            for (std::size_t i = 0; i < iterations; ++i)
+                sink = sink + (left == right ? 1 : 0);
+        });
+    }
+
+    // Measure getting then setting each of the given number of int64 properties in turn, in a
+    // property_map, in a property_store by name, and in a property_store by property_ref, in
+    // nanoseconds per get and set.
+    inline void property_get_set(std::size_t property_count)
+    {
+        std::vector<das::name_t> names{};
+        for (std::size_t i = 0; i < property_count; ++i) names.push_back(das::name_t("property" + std::to_string(i)));
+
+        das::property_map properties{};
+        for (const auto& name : names) properties[name] = std::make_unique<das::property<std::int64_t>>(0);
+        run("property_map_get_set", property_count, [&](std::size_t iterations)
+        {
+            for (std::size_t i = 0; i < iterations; ++i)
+            {
+                auto& property = das::get_property<std::int64_t>(properties, names[i % property_count]);
+                das::set_value(property, das::get_value(property) + 1);
+            }
+        });
+
+        das::property_store store;
+        std::vector<das::property_ref<std::int64_t>> refs{};
+        for (const auto& name : names) refs.push_back(das::set_property(store, name, std::int64_t(0)));
+        run("property_store_get_set", property_count, [&](std::size_t iterations)
+        {
+            for (std::size_t i = 0; i < iterations; ++i)
+            {
+                const auto ref = das::get_property_ref<std::int64_t>(store, names[i % property_count]);
+                das::set_value(ref, das::get_value(ref) + 1);
+            }
+        });
+        run("property_ref_get_set", property_count, [&](std::size_t iterations)
+        {
+            for (std::size_t i = 0; i < iterations; ++i)
+            {
+                const auto& ref = refs[i % property_count];
+                das::set_value(ref, das::get_value(ref) + 1);
+            }
+        });
+    }
+
+    // Measure writing each property of 256 stores of 4 float properties the given number of times
+    // per frame, publishing an event by hand after every write versus flushing the changes of
+    // observed stores once per frame, in nanoseconds per write.
+    inline void property_change_frame(std::size_t write_count)
+    {
+        const std::size_t store_count = 256;
+        const std::size_t property_count = 4;
+        std::vector<das::name_t> names{};
+        for (std::size_t i = 0; i < property_count; ++i) names.push_back(das::name_t("property" + std::to_string(i)));
+        event_program program{};
+        const auto publisher = std::make_shared<das::addressable>(das::name_t("publisher"));
+        das::subscribe_event<float>(program, das::address("entity/**"), publisher, [](const das::event<float>& event, event_program&) { sink = sink + static_cast<std::size_t>(event.data); return true; });
+        das::subscribe_event<das::property_change>(program, das::address("entity/**"), publisher, [](const das::event<das::property_change>& event, event_program&) { sink = sink + event.data.row; return true; });
+
+        std::vector<std::unique_ptr<das::property_store>> stores{};
+        std::vector<das::property_ref<float>> refs{};
+        std::vector<das::address> addresses{};
+        for (std::size_t i = 0; i < store_count; ++i)
+        {
+            const auto store_address = das::address("entity/" + std::to_string(i));
+            stores.push_back(std::make_unique<das::property_store>());
+            for (const auto& name : names)
+            {
+                refs.push_back(das::set_property(*stores.back(), name, 0.0f));
+                addresses.push_back(store_address + das::address(name));
+            }
+        }
+        const auto write_total = refs.size() * write_count;
+        run("property_publish_per_write", write_count, [&](std::size_t iterations)
+        {
+            for (std::size_t i = 0; i < iterations; i += write_total)
+                for (std::size_t j = 0; j < write_count; ++j)
+                    for (std::size_t k = 0; k < refs.size(); ++k)
+                        das::publish_event(program, das::set_value(refs[k], static_cast<float>(j)), addresses[k], publisher);
+        });
+
+        for (std::size_t i = 0; i < store_count; ++i) das::observe_property_changes(program, *stores[i], das::address("entity/" + std::to_string(i)), publisher);
+        run("property_flush_per_frame", write_count, [&](std::size_t iterations)
+        {
+            for (std::size_t i = 0; i < iterations; i += write_total)
+            {
+                for (std::size_t j = 0; j < write_count; ++j)
+                    for (const auto& ref : refs)
+                        das::set_value(ref, static_cast<float>(j));
+                das::flush_property_changes(program);
+            }
+        });
+        for (const auto& store : stores) das::unobserve_property_changes(*store);
+    }
+
+    inline void split_string(std::size_t segment_count)
+    {
+        const auto str = make_address_str(segment_count);
+        run("split_string", segment_count, [&](std::size_t iterations)
+        {
+            for (std::size_t i = 0; i < iterations; ++i)
+                sink = sink + das::split_string(str, '/').size();
+        });
+    }
+
+    // Write how many of a set of addresses collide in their full hashes, and how many collide in
+    // the buckets of a table with as many buckets as addresses, next to the same for the old XOR
+    // of their name hashes as a baseline. For an ideal hash, about 37% collide in the buckets.
+    inline void address_hash_collisions(const std::string& set_name, const std::vector<das::address>& addresses)
+    {
+        for (VAL xor_hash : { false, true })
+        {
+            std::unordered_set<std::size_t> hashes{};
+            std::unordered_set<std::size_t> buckets{};
+            for (VAL& address : addresses)
+            {
+                std::size_t hash = 0;
+                if (xor_hash) for (VAL& name : das::get_names(address)) hash ^= das::get_hash(name);
+                else hash = static_cast<std::size_t>(address);
+                hashes.insert(hash);
+                buckets.insert(hash % addresses.size());
+            }
+            std::cout << set_name << ',' << (xor_hash ? "xor" : "sequence") << ',' << addresses.size() << ',';
+            std::cout << addresses.size() - hashes.size() << ',' << addresses.size() - buckets.size() << std::endl;
+        }
+    }
+
+    // Write the hash collisions of sets of addresses shaped like those of real programs.
+    inline void address_hash_collisions()
+    {
+        std::cout << "address_set,hash,addresses,hash_collisions,bucket_collisions" << std::endl;
+        const std::vector<std::string> components{ "transform", "physics", "render", "audio", "script" };
+        std::vector<das::address> entities{};
+        for (std::size_t i = 0; i < 20000; ++i)
+            for (const auto& component : components)
+                entities.push_back(das::address("entity/" + std::to_string(i) + "/" + component + "/changed"));
+        address_hash_collisions("entities", entities);
+
+        std::vector<das::address> grid{};
+        for (std::size_t x = 0; x < 300; ++x)
+            for (std::size_t y = 0; y < 300; ++y)
+                grid.push_back(das::address("world/" + std::to_string(x) + "/" + std::to_string(y)));
+        address_hash_collisions("grid", grid);
+
+        // every sequence of one to four of ten names, including repeated ones like 'a/a'
+        std::vector<das::address> permutations{};
+        std::vector<das::address> previous{ das::address(std::vector<das::name_t>{}) };
+        for (std::size_t depth = 1; depth <= 4; ++depth)
+        {
+            std::vector<das::address> current{};
+            for (const auto& prefix : previous)
+                for (char c = 'a'; c < 'a' + 10; ++c)
+                    current.push_back(prefix + das::address(das::name_t(std::string(1, c))));
+            permutations.insert(permutations.end(), current.begin(), current.end());
+            previous = current;
+        }
+        address_hash_collisions("permutations", permutations);
+    }
+
+    // Measure the rate at which the given number of threads can publish to an address with the
+    // given number of subscribers, in nanoseconds per publish per thread.
+    inline void publish_event_concurrent(std::size_t thread_count, std::size_t subscriber_count)
+    {
+        concurrent_program program;
+        const auto event_address = das::address("bench/event");
+        const auto participant = std::make_shared<das::addressable>(das::name_t("participant"));
+        for (std::size_t i = 0; i < subscriber_count; ++i)
+        {
+            das::subscribe_event_concurrent<std::int64_t, concurrent_program>(program, event_address, participant, [](const auto& event, auto&)
+            {
+                return event.data >= 0;
+            });
+        }
+        run("publish_event_concurrent_threads", thread_count, [&](std::size_t iterations)
+        {
+            std::atomic<bool> started(false);
+            std::vector<std::thread> threads;
+            for (std::size_t i = 0; i < thread_count; ++i)
+            {
+                threads.emplace_back([&]()
+                {
+                    while (!started.load()) std::this_thread::yield();
+                    for (std::size_t j = 0; j < iterations; ++j)
+                        das::publish_event_concurrent(program, static_cast<std::int64_t>(j), event_address, participant);
+                });
+            }
+            started.store(true);
+            for (auto& thread : threads) thread.join();
+        });
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    /// report address hash collisions instead, if asked
+    if (argc > 1 && std::string(argv[1]) == "--collisions")
+    {
+        bench::address_hash_collisions();
+        return 0;
+    }
+
+    /// only run the benchmarks whose names contain the first argument, if given
+    if (argc > 1) bench::filter = argv[1];
+
+    /// write results as CSV, one row per benchmark and parameter
+    std::cout << "benchmark,parameter,iterations,ns_per_op" << std::endl;
+    for (std::size_t subscriber_count : { 1, 4, 16, 64, 256 }) bench::publish_event_fan_out(subscriber_count);
+    for (std::size_t subscription_count : { 0, 64, 1024 }) bench::subscribe_unsubscribe_churn(subscription_count);
+    for (std::size_t depth : { 1, 4, 16 }) bench::address_from_string(depth);
+    bench::address_from_literal();
+    for (std::size_t depth : { 3, 7, 15 }) bench::address_append(depth);
+    for (std::size_t length : { 4, 16, 64 }) bench::name_hash(length);
+    for (std::size_t length : { 4, 16, 64 }) bench::name_equality(length);
+    bench::try_cast_depth<1>();
+    bench::try_cast_depth<2>();
+    bench::try_cast_depth<4>();
+    bench::try_cast_depth<8>();
+    for (std::size_t object_count : { 1000, 100000 }) bench::castable_iteration(object_count);
+    for (std::size_t segment_count : { 1, 4, 16 }) bench::split_string(segment_count);
+    for (std::size_t property_count : { 8, 64, 4096 }) bench::property_get_set(property_count);
+    for (std::size_t write_count : { 1, 4, 16 }) bench::property_change_frame(write_count);
+
+    /// publish from 1 to N threads, where N is the number of hardware threads
+    const auto thread_count_max = std::max(1u, std::thread::hardware_concurrency());
+    for (std::size_t thread_count = 1; thread_count <= thread_count_max; thread_count *= 2)
+        bench::publish_event_concurrent(thread_count, 16);
+    return 0;
+}
+
+#endif
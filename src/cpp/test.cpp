@@ -0,0 +1,499 @@
+#ifdef TEST_CPP
+
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#if defined(__linux__)
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "../hpp/das/prelude.hpp"
+#include "../hpp/das/id.hpp"
+#include "../hpp/das/inline_vector.hpp"
+#include "../hpp/das/castable.hpp"
+#include "../hpp/das/castable_pool.hpp"
+#include "../hpp/das/addressable.hpp"
+#include "../hpp/das/address.hpp"
+#include "../hpp/das/property_store.hpp"
+#include "../hpp/das/eventable.hpp"
+#include "../hpp/das/event_awaiter.hpp"
+#include "../hpp/das/event_stats.hpp"
+#include "../hpp/das/event_log.hpp"
+#include "../hpp/das/event_player.hpp"
+#if defined(__linux__)
+#include "../hpp/das/event_bus.hpp"
+#endif
+
+namespace test
+{
+    // A trivially copyable event type.
+    struct moved
+    {
+        int index;
+        double distance;
+    };
+}
+
+namespace das
+{
+    template<>
+    struct event_serializer<test::moved> : public trivial_event_serializer<test::moved>
+    {
+        static const char* get_name() { return "test::moved"; }
+    };
+}
+
+namespace test
+{
+    // The number of checks that failed.
+    std::size_t failures;
+
+    // Check that a condition holds, writing what was expected if it does not.
+    inline void check(bool condition, const std::string& expectation)
+    {
+        if (condition) return;
+        std::cout << "FAILED: " << expectation << std::endl;
+        ++failures;
+    }
+
+    // A trivial program type to test the eventable program mixin.
+    class event_program : public das::eventable<event_program>
+    {
+    protected:
+
+        ENABLE_CAST(event_program, das::eventable<event_program>);
+    };
+
+    // An element whose copies throw once a given number of them have been made, and whose moves
+    // may throw, so that growing vectors must copy it.
+    struct copy_fallible
+    {
+        static int copies_left;
+
+        int value;
+
+        explicit copy_fallible(int value) : value(value) { }
+        copy_fallible(copy_fallible&& that) : value(that.value) { }
+
+        copy_fallible(const copy_fallible& that) : value(that.value)
+        {
+            if (copies_left-- == 0) throw std::runtime_error("Thrown from a copy.");
+        }
+    };
+
+    int copy_fallible::copies_left = -1;
+
+    // An inline_vector moves without throwing when its elements do, so standard containers move
+    // rather than copy it, and an element that throws while it grows leaves it as it was.
+    inline void inline_vector_exception_safety()
+    {
+        check(std::is_nothrow_move_constructible<das::inline_vector<int, 4>>::value, "an inline_vector of nothrow movable elements is nothrow movable");
+        check(std::is_nothrow_move_constructible<das::address>::value, "an address is nothrow movable");
+        check(!std::is_nothrow_move_constructible<das::inline_vector<copy_fallible, 4>>::value, "an inline_vector of elements whose moves may throw may throw on moving");
+
+        das::inline_vector<copy_fallible, 4> elements{};
+        for (int i = 0; i < 4; ++i) elements.push_back(copy_fallible(i));
+        copy_fallible::copies_left = 2;
+        bool thrown = false;
+        try { elements.push_back(copy_fallible(4)); }
+        catch (const std::runtime_error&) { thrown = true; }
+        copy_fallible::copies_left = -1;
+        bool intact = elements.size() == 4;
+        for (std::size_t i = 0; intact && i < elements.size(); ++i) intact = elements[i].value == static_cast<int>(i);
+        check(thrown && intact, "an element that throws while an inline_vector grows leaves the vector as it was");
+        elements.push_back(copy_fallible(4));
+        check(elements.size() == 5 && elements[4].value == 4, "an inline_vector grows once its elements stop throwing");
+    }
+
+    // A thread alternating between generators keeps drawing on each one's block of ids.
+    inline void id_generator_alternating()
+    {
+        das::id_generator generator_first{};
+        das::id_generator generator_second{};
+        bool contiguous = true;
+        for (int i = 0; i < 1000; ++i)
+        {
+            contiguous = contiguous && das::generate_id(generator_first).x == i + 1;
+            contiguous = contiguous && das::generate_id(generator_second).x == i + 1;
+        }
+        check(contiguous, "generators used in turn each hand out the ids of a single block");
+    }
+
+    // A castable whose constructor throws when asked to.
+    class castable_fallible : public das::castable
+    {
+    protected:
+
+        ENABLE_CAST(castable_fallible, das::castable);
+
+    public:
+
+        const int value;
+
+        castable_fallible(int value, bool fail) : value(value)
+        {
+            if (fail) throw std::runtime_error("Thrown from a constructor.");
+        }
+    };
+
+    // An object whose constructor throws leaves no object or slot behind in its pool.
+    inline void castable_pool_constructor_exception()
+    {
+        das::castable_pool pool{};
+        const auto handle_first = das::add_castable<castable_fallible>(pool, 1, false);
+        bool thrown = false;
+        try { das::add_castable<castable_fallible>(pool, 2, true); }
+        catch (const std::runtime_error&) { thrown = true; }
+        check(thrown, "an exception from an object's constructor propagates out of add_castable");
+        const auto handle_second = das::add_castable<castable_fallible>(pool, 3, false);
+        check(handle_second.slot_index == handle_first.slot_index + 1, "the slot of an object whose constructor threw is reused");
+        int sum = 0;
+        std::size_t count = 0;
+        das::for_each<castable_fallible>(pool, [&](castable_fallible& object) { sum += object.value; ++count; });
+        check(count == 2 && sum == 4, "an object whose constructor threw is not visited");
+    }
+
+    // Compaction reclaims the subscriptions of dead subscribers, counting them however the
+    // compaction came about, and removes the channels and addresses left empty.
+    inline void subscriptions_compaction()
+    {
+        event_program program{};
+        const auto participant = std::make_shared<das::addressable>(das::name_t("participant"));
+        for (int i = 0; i < 100; ++i)
+        {
+            const auto subscriber = std::make_shared<das::addressable>(das::name_t("subscriber"));
+            das::subscribe_event<int, event_program>(program, das::address("entity/" + std::to_string(i)), subscriber, [](const das::event_view<int>&, event_program&) { return true; });
+            das::subscribe_event<int, event_program>(program, das::address("entity/" + std::to_string(i) + "/*"), subscriber, [](const das::event_view<int>&, event_program&) { return true; });
+        }
+        std::size_t reclaimed = 0;
+        for (int i = 0; i < 100; ++i) reclaimed += das::compact_subscriptions(program, 7);
+        check(reclaimed == 200 && das::get_reclaimed_subscription_count(program) == 200, "compacting in bounded steps reclaims every dead subscription once");
+        check(das::compact_subscriptions(program) == 0, "compacting again reclaims nothing");
+
+        int delivered = 0;
+        das::subscribe_event<int, event_program>(program, das::address("entity/3"), participant, [&](const das::event_view<int>&, event_program&) { ++delivered; return true; });
+        das::subscribe_event<int, event_program>(program, das::address("entity/3/*"), participant, [&](const das::event_view<int>&, event_program&) { ++delivered; return true; });
+        das::publish_event(program, 1, das::address("entity/3"), participant);
+        das::publish_event(program, 1, das::address("entity/3/x"), participant);
+        check(delivered == 2, "an address whose channels were removed may be subscribed to again");
+
+        das::unsubscriber<event_program> unsubscribers[2];
+        unsubscribers[0] = das::subscribe_event<int, event_program>(program, das::address("shared"), participant, [](const das::event_view<int>&, event_program&) { return true; });
+        unsubscribers[1] = das::subscribe_event<int, event_program>(program, das::address("shared"), participant, [](const das::event_view<int>&, event_program&) { return true; });
+        {
+            const auto subscriber = std::make_shared<das::addressable>(das::name_t("subscriber"));
+            das::subscribe_event<int, event_program>(program, das::address("shared"), subscriber, [](const das::event_view<int>&, event_program&) { return true; });
+        }
+        for (const auto& unsubscriber : unsubscribers) unsubscriber(program);
+        check(das::get_reclaimed_subscription_count(program) == 201, "a compaction on unsubscribing counts the dead subscriptions it reclaims");
+    }
+
+    // The statistics of ever new addresses stay bounded, keeping those published to most often.
+    inline void event_stats_address_eviction()
+    {
+        das::event_stats stats{};
+        for (int i = 0; i < 100; ++i) das::record_event_publish(stats, das::address("hot"));
+        for (int i = 0; i < 100000; ++i) das::record_event_publish(stats, das::address("entity/" + std::to_string(i)));
+        std::ostringstream stream{};
+        das::write_event_stats(stream, stats, 1000000);
+        std::size_t address_count = 0;
+        std::string line{};
+        std::istringstream lines(stream.str());
+        std::getline(lines, line);
+        while (std::getline(lines, line) && line.compare(0, 13, "subscription,") != 0) ++address_count;
+        std::istringstream first_lines(stream.str());
+        std::getline(first_lines, line);
+        std::getline(first_lines, line);
+        check(address_count < 100000, "the statistics of addresses are bounded");
+        check(line.compare(0, 8, "hot,100,") == 0, "the address published to most often outlives eviction");
+    }
+
+    // A handler may flush its program's property changes again, and may destroy a store the
+    // outer flush has yet to reach, with each change published once.
+    inline void property_changes_nested_flush()
+    {
+        event_program program{};
+        const auto participant = std::make_shared<das::addressable>(das::name_t("participant"));
+        das::property_store store_first{};
+        das::property_store store_nested{};
+        auto store_destroyed = std::make_unique<das::property_store>();
+        das::observe_property_changes(program, store_first, das::address("first"), participant);
+        das::observe_property_changes(program, store_nested, das::address("nested"), participant);
+        das::observe_property_changes(program, *store_destroyed, das::address("destroyed"), participant);
+        std::size_t nested_count = 0;
+        std::size_t nested_published = 0;
+        das::subscribe_event<das::property_change, event_program>(program, das::address("first/**"), participant, [&](const das::event<das::property_change>&, event_program& program)
+        {
+            das::set_property<int>(store_nested, das::name_t("value"), 2);
+            nested_count = das::flush_property_changes(program);
+            store_destroyed.reset();
+            return true;
+        });
+        das::subscribe_event<das::property_change, event_program>(program, das::address("nested/**"), participant, [&](const das::event<das::property_change>&, event_program&)
+        {
+            ++nested_published;
+            return true;
+        });
+        das::set_property<int>(store_first, das::name_t("value"), 1);
+        das::set_property<int>(*store_destroyed, das::name_t("value"), 3);
+        check(das::flush_property_changes(program) == 1, "a flush publishes only the changes of stores still observed");
+        check(nested_count == 1 && nested_published == 1, "a nested flush publishes the changes made before it");
+        check(das::flush_property_changes(program) == 0, "changes flushed by a nested flush are not published again");
+        das::set_property<int>(store_nested, das::name_t("value"), 4);
+        check(das::flush_property_changes(program) == 1 && nested_published == 2, "a flush after a nested flush publishes new changes");
+    }
+
+    // A handler may add properties to the store being flushed or unobserve it, and a handler
+    // that throws leaves the changes not yet published for the next flush.
+    inline void property_changes_handler_edits()
+    {
+        event_program program{};
+        const auto participant = std::make_shared<das::addressable>(das::name_t("participant"));
+        das::property_store store{};
+        das::observe_property_changes(program, store, das::address("s"), participant);
+        std::size_t published = 0;
+        das::subscribe_event<das::property_change, event_program>(program, das::address("s/a"), participant, [&](const das::event<das::property_change>&, event_program&)
+        {
+            for (int i = 0; i < 64; ++i) das::set_property<int>(store, das::name_t("added" + std::to_string(i)), i);
+            return true;
+        });
+        das::subscribe_event<das::property_change, event_program>(program, das::address("s/*"), participant, [&](const das::event<das::property_change>&, event_program&)
+        {
+            ++published;
+            return true;
+        });
+        das::set_property<int>(store, das::name_t("a"), 1);
+        check(das::flush_property_changes(program) == 1 && published == 1, "a change is published to every subscription after a handler adds properties");
+        check(das::flush_property_changes(program) == 64 && published == 65, "properties added by a handler are published by the next flush");
+
+        das::subscribe_event<das::property_change, event_program>(program, das::address("s/b"), participant, [&](const das::event<das::property_change>&, event_program&) -> bool
+        {
+            throw std::runtime_error("Thrown from a handler.");
+        });
+        das::set_property<int>(store, das::name_t("b"), 2);
+        das::set_property<int>(store, das::name_t("c"), 3);
+        bool thrown = false;
+        try { das::flush_property_changes(program); }
+        catch (const std::runtime_error&) { thrown = true; }
+        check(thrown, "an exception from a handler propagates out of a flush");
+        published = 0;
+        check(das::flush_property_changes(program) == 1 && published == 1, "the changes after one whose publish threw are published by the next flush");
+
+        das::subscribe_event<das::property_change, event_program>(program, das::address("s/d"), participant, [&](const das::event<das::property_change>&, event_program&)
+        {
+            das::unobserve_property_changes(store);
+            return true;
+        });
+        das::set_property<int>(store, das::name_t("d"), 4);
+        das::set_property<int>(store, das::name_t("e"), 5);
+        check(das::flush_property_changes(program) == 1, "the remaining changes of a store unobserved by a handler are dropped");
+    }
+
+    // Events recorded from one program are replayed into another in the order they were
+    // published, with their addresses and payloads, even when a name holds a '/'.
+    inline void event_log_round_trip()
+    {
+        const std::string file_path = "das_test_events.log";
+        const auto participant = std::make_shared<das::addressable>(das::name_t("participant"));
+        const auto address_slashed = das::address(std::vector<std::string>{ "world", "a/b" });
+        {
+            das::event_recorder recorder(file_path);
+            event_program program{};
+            das::set_event_recorder(program, &recorder);
+            das::publish_event(program, moved{ 1, 0.5 }, das::address("world/zone/a"), participant);
+            das::publish_event(program, std::string("hello"), das::address("world/chat"), participant);
+            das::publish_event(program, 7, das::address("world/unrecorded"), participant);
+            das::publish_event(program, moved{ 2, 1.5 }, address_slashed, participant);
+            das::set_event_recorder(program, nullptr);
+        }
+
+        std::vector<std::string> replayed{};
+        std::vector<das::address> replayed_addresses{};
+        event_program program{};
+        das::subscribe_event<moved, event_program>(program, das::address("world/**"), participant, [&](const das::event_view<moved>& event, event_program&)
+        {
+            replayed.push_back("moved " + std::to_string(event.data.index) + " " + std::to_string(event.data.distance));
+            replayed_addresses.push_back(event.address);
+            return true;
+        });
+        das::subscribe_event<std::string, event_program>(program, das::address("world/**"), participant, [&](const das::event_view<std::string>& event, event_program&)
+        {
+            replayed.push_back("string " + event.data);
+            replayed_addresses.push_back(event.address);
+            return true;
+        });
+        {
+            das::event_player<event_program> player(file_path);
+            das::register_event_replay<moved>(player);
+            das::register_event_replay<std::string>(player);
+            check(das::get_event_log_size(player) == 3, "only events of serializable types are recorded");
+            check(das::replay_events(program, player, participant) == 3, "every recorded event of a registered type is replayed");
+        }
+        std::remove(file_path.c_str());
+        check(
+            replayed == std::vector<std::string>{ "moved 1 " + std::to_string(0.5), "string hello", "moved 2 " + std::to_string(1.5) },
+            "replayed events keep their order and payloads");
+        check(
+            replayed_addresses.size() == 3 &&
+            replayed_addresses[0] == das::address("world/zone/a") &&
+            replayed_addresses[1] == das::address("world/chat") &&
+            replayed_addresses[2] == address_slashed,
+            "replayed events keep their addresses, even with a '/' in a name");
+    }
+
+#if defined(__linux__)
+    // Events mirrored by a sender in a forked process are received in order, those that find the
+    // ring full are dropped and counted, and a sender destroyed while mirroring sends nothing.
+    inline void event_bus_round_trip()
+    {
+        const auto ring_name = "/das_test_" + std::to_string(getpid());
+        const auto bridge = std::make_shared<das::addressable>(das::name_t("bridge"));
+        const auto participant = std::make_shared<das::addressable>(das::name_t("participant"));
+        das::event_bus_receiver<event_program> receiver(ring_name, 4096, bridge);
+        das::receive_events<moved>(receiver);
+        das::receive_events<std::string>(receiver);
+
+        const auto child = fork();
+        if (child == 0)
+        {
+            // send one event of each kind, then fill the ring and try three sends past full
+            event_program program{};
+            das::event_bus_sender<event_program> sender(ring_name, bridge);
+            das::mirror_events<moved>(program, sender, das::address("world/**"));
+            das::mirror_events<std::string>(program, sender, das::address("world/**"));
+            das::publish_event(program, moved{ -1, 2.5 }, das::address("world/zone/a"), participant);
+            das::publish_event(program, std::string("hello"), das::address("world/chat"), participant);
+            int index = 0;
+            while (das::send_event(sender, moved{ index, 0.0 }, das::address("world/fill"))) ++index;
+            das::send_event(sender, moved{ index, 0.0 }, das::address("world/fill"));
+            das::send_event(sender, moved{ index, 0.0 }, das::address("world/fill"));
+            das::stop_mirroring_events(program, sender);
+            _exit(das::get_dropped_events(sender) == 3 ? 0 : 1);
+        }
+        int status = 0;
+        check(child > 0 && waitpid(child, &status, 0) == child, "a sender process can be forked and waited on");
+        check(WIFEXITED(status) && WEXITSTATUS(status) == 0, "a sender counts each event that finds the ring full as dropped");
+
+        event_program program{};
+        std::vector<moved> moves{};
+        std::vector<das::address> move_addresses{};
+        std::string chat{};
+        das::subscribe_event<moved, event_program>(program, das::address("world/**"), participant, [&](const das::event_view<moved>& event, event_program&)
+        {
+            moves.push_back(event.data);
+            move_addresses.push_back(event.address);
+            return true;
+        });
+        das::subscribe_event<std::string, event_program>(program, das::address("world/chat"), participant, [&](const das::event_view<std::string>& event, event_program&)
+        {
+            chat += event.data;
+            return true;
+        });
+        const auto received = das::pump_events(program, receiver);
+        check(received == moves.size() + 1 && moves.size() > 2, "every event sent before the ring filled is received");
+        check(!moves.empty() && moves[0].index == -1 && moves[0].distance == 2.5 && move_addresses[0] == das::address("world/zone/a"), "a trivially copyable event arrives with its payload and address");
+        check(chat == "hello", "a serialized event arrives with its payload");
+        bool ordered = true;
+        for (std::size_t i = 1; i < moves.size(); ++i) ordered = ordered && moves[i].index == static_cast<int>(i) - 1 && move_addresses[i] == das::address("world/fill");
+        check(ordered, "events arrive in the order they were sent");
+        check(das::get_dropped_events(receiver) == 0, "a receiver drops no well-formed records");
+
+        // a sender destroyed without stopping its mirroring leaves nothing for the program to call
+        event_program program_sending{};
+        {
+            das::event_bus_sender<event_program> sender(ring_name, bridge);
+            das::mirror_events<moved>(program_sending, sender, das::address("world/**"));
+        }
+        das::publish_event(program_sending, moved{ 0, 0.0 }, das::address("world/zone/a"), participant);
+        check(das::pump_events(program, receiver) == 0, "a destroyed sender sends nothing");
+    }
+#endif
+
+#if defined(__cpp_impl_coroutine)
+    inline das::event_task await_then_throw(event_program& program, int& awaited)
+    {
+        const auto event = co_await das::next_event<int>(program, das::address("test/throw"));
+        awaited = event.data;
+        throw std::runtime_error("Thrown from a coroutine.");
+    }
+
+    inline das::event_task await_then_resume(event_program& program, bool& resumed)
+    {
+        co_await das::next_event<int>(program, das::address("test/wait"));
+        resumed = true;
+    }
+
+    // An exception that escapes a coroutine finishes it and is kept by its task, while the
+    // publisher that resumed it carries on.
+    inline void event_task_exception()
+    {
+        event_program program{};
+        const auto participant = std::make_shared<das::addressable>(das::name_t("participant"));
+        int awaited = 0;
+        const auto task = await_then_throw(program, awaited);
+        check(!das::is_task_done(task), "a task awaiting an event is not done");
+        das::publish_event(program, 7, das::address("test/throw"), participant);
+        check(awaited == 7, "a task is resumed by the event it awaits");
+        check(das::is_task_done(task), "a task that threw is done");
+        std::string what{};
+        try { if (const auto exception = das::get_task_exception(task)) std::rethrow_exception(exception); }
+        catch (const std::runtime_error& exception) { what = exception.what(); }
+        check(what == "Thrown from a coroutine.", "a task keeps the exception that escaped it");
+    }
+
+    // A task awaiting an event when its program is destroyed is never resumed, yet may still be
+    // destroyed afterwards, and a task destroyed before its program stops awaiting.
+    inline void event_task_outlives_program()
+    {
+        const auto participant = std::make_shared<das::addressable>(das::name_t("participant"));
+        bool resumed = false;
+        das::event_task task{};
+        {
+            event_program program{};
+            task = await_then_resume(program, resumed);
+        }
+        check(!resumed && !das::is_task_done(task), "a task awaiting a destroyed program is never resumed");
+        task = das::event_task();
+        check(das::is_task_done(task), "an empty task is done");
+
+        event_program program{};
+        {
+            const auto task_destroyed = await_then_resume(program, resumed);
+        }
+        das::publish_event(program, 1, das::address("test/wait"), participant);
+        check(!resumed, "a destroyed task is not resumed");
+    }
+#endif
+}
+
+int main(int, char*[])
+{
+    /// run each test, counting the checks that fail
+    test::inline_vector_exception_safety();
+    test::id_generator_alternating();
+    test::castable_pool_constructor_exception();
+    test::subscriptions_compaction();
+    test::event_stats_address_eviction();
+    test::property_changes_nested_flush();
+    test::property_changes_handler_edits();
+    test::event_log_round_trip();
+#if defined(__linux__)
+    test::event_bus_round_trip();
+#endif
+#if defined(__cpp_impl_coroutine)
+    test::event_task_exception();
+    test::event_task_outlives_program();
+#endif
+
+    /// report the result through the exit code as well
+    std::cout << (test::failures == 0 ? "All checks passed." : "Some checks failed.") << std::endl;
+    return test::failures == 0 ? 0 : 1;
+}
+
+#endif
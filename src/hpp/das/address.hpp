@@ -11,20 +11,81 @@
 #include "string.hpp"
 #include "hash.hpp"
 #include "name.hpp"
+#include "inline_vector.hpp"
 
 namespace das
 {
-    // The address of an event or a participant.
+    // The names of an address, stored inline up to the depth of nearly every address.
+    using address_names = inline_vector<name_t, 4>;
+
+    // An address parsed and hashed at compile time, from which an address can be constructed
+    // without parsing or hashing. Made by DAS_ADDRESS. Its names are split on '/' just as for an
+    // address constructed from a string.
+    template<std::size_t N>
+    struct address_literal
+    {
+        const char* names_str;
+        std::size_t name_count;
+        std::size_t name_offsets[N];
+        std::size_t name_sizes[N];
+        std::size_t name_hashes[N];
+        std::size_t hash_code;
+
+        constexpr explicit address_literal(const char (&names_str)[N]) :
+            names_str(names_str),
+            name_count(),
+            name_offsets(),
+            name_sizes(),
+            name_hashes(),
+            hash_code()
+        {
+            std::size_t begin = 0;
+            for (std::size_t end = 0; end <= N - 1; ++end)
+            {
+                if (end == N - 1 ? begin != end : names_str[end] == '/')
+                {
+                    name_offsets[name_count] = begin;
+                    name_sizes[name_count] = end - begin;
+                    name_hashes[name_count] = get_name_hash(names_str + begin, end - begin);
+                    hash_code = extend_hash(hash_code, name_hashes[name_count]);
+                    ++name_count;
+                    begin = end + 1;
+                }
+            }
+        }
+    };
+
+    // The address of an event or a participant. Addresses of up to four names never allocate
+    // their names on the heap, so they are cheap to construct and copy.
+    //
+    // An address' hash is the sequence hash of its names, so addresses of the same names in a
+    // different order hash differently, and concatenating addresses derives the hash from theirs.
     class address
     {
     private:
 
         std::size_t hash_code;
-        std::vector<name_t> names;
+        address_names names;
+
+        address(address_names&& names_mvb, std::size_t hash_code) : hash_code(hash_code), names(std::move(names_mvb)) { }
+
+        static address_names parse_names(const std::string& names_str)
+        {
+            // like split_string, but without building a vector of strings first
+            address_names names{};
+            std::size_t begin = 0;
+            for (VAR end = names_str.find('/'); end != std::string::npos; end = names_str.find('/', begin))
+            {
+                names.push_back(name_t(names_str.substr(begin, end - begin)));
+                begin = end + 1;
+            }
+            if (begin != names_str.size()) names.push_back(name_t(names_str.substr(begin)));
+            return names;
+        }
 
     protected:
 
-        friend const std::vector<name_t>& get_names(const address& address);
+        friend const address_names& get_names(const address& address);
 
     public:
 
@@ -34,25 +95,40 @@ namespace das
         address& operator=(const address&) = default;
         address& operator=(address&&) = default;
 
-        explicit address(const name_t& name) : hash_code(get_hash(name)), names({ name }) { }
-        explicit address(const std::vector<name_t>& names) : hash_code(get_hash_range<name_t>(names.cbegin(), names.cend())), names(names) { }
-        explicit address(std::vector<name_t>&& names_mvb) : hash_code(get_hash_range<name_t>(names_mvb.cbegin(), names_mvb.cend())), names(names_mvb) { }
+        explicit address(const name_t& name) : hash_code(extend_hash(0, get_hash(name))), names({ name }) { }
+        explicit address(const address_names& names) : hash_code(get_hash_range<name_t>(names.cbegin(), names.cend())), names(names) { }
+        explicit address(address_names&& names_mvb) : hash_code(get_hash_range<name_t>(names_mvb.cbegin(), names_mvb.cend())), names(std::move(names_mvb)) { }
+        explicit address(const std::vector<name_t>& names) : address(address_names(names.cbegin(), names.cend())) { }
         explicit address(const std::vector<std::string>& names) : address(std::transform<std::vector<name_t>>(names.cbegin(), names.cend(), [](VAL& name) { return name_t(name); })) { }
         explicit address(const char* names_str) : address(std::string(names_str)) { }
-        explicit address(const std::string& names_str) : address(split_string(names_str, '/')) { }
+        explicit address(const std::string& names_str) : address(parse_names(names_str)) { }
+
+        template<std::size_t N>
+        explicit address(const address_literal<N>& literal) : hash_code(literal.hash_code), names()
+        {
+            names.reserve(literal.name_count);
+            for (std::size_t i = 0; i < literal.name_count; ++i)
+                names.push_back(make_name_hashed(literal.names_str + literal.name_offsets[i], literal.name_sizes[i], literal.name_hashes[i]));
+#ifdef DAS_INTERNED_NAMES
+            // interned names hash by their index, which is only known now
+            hash_code = get_hash_range<name_t>(names.cbegin(), names.cend());
+#endif
+        }
 
-        bool address::operator==(const address& that) const
+        bool operator==(const address& that) const
         {
             return
                 hash_code == that.hash_code && // OPTIMIZATION: assuming hash_code check could hasten eq chacks
                 names == that.names;
         }
 
-        address address::operator+(const address& right) const
+        address operator+(const address& right) const
         {
-            std::vector<name_t> names_summed(names.cbegin(), names.cend());
+            address_names names_summed{};
+            names_summed.reserve(names.size() + right.names.size());
+            for (VAL& name : names) names_summed.push_back(name);
             for (VAL& name : right.names) names_summed.push_back(name);
-            return address(names_summed);
+            return address(std::move(names_summed), concat_hash(hash_code, right.hash_code, right.names.size()));
         }
 
         explicit operator std::size_t() const { return hash_code; }
@@ -60,12 +136,22 @@ namespace das
 
 
     // Get the names of which an address consists.
-    const std::vector<name_t>& get_names(const address& address)
+    inline const address_names& get_names(const address& address)
     {
         return address.names;
     }
 }
 
+// Get a reference to the address of a string literal, which is parsed and hashed at compile time,
+// and constructed just once, on first use.
+#define DAS_ADDRESS(names_str) \
+    ([]() -> const ::das::address& \
+    { \
+        static constexpr ::das::address_literal<sizeof(names_str)> literal(names_str); \
+        static const ::das::address address_constructed(literal); \
+        return address_constructed; \
+    }())
+
 namespace std
 {
     template<>
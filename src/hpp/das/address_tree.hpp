@@ -0,0 +1,184 @@
+#ifndef DAS_ADDRESS_TREE_HPP
+#define DAS_ADDRESS_TREE_HPP
+
+#include <cstddef>
+#include <memory>
+#include <unordered_map>
+
+#include "prelude.hpp"
+#include "hash.hpp"
+#include "name.hpp"
+#include "inline_vector.hpp"
+#include "address.hpp"
+
+namespace das
+{
+    // An address as a node of an address tree, linked to the node of its parent address. A node
+    // stores just its last name, so addresses that share a prefix share the nodes of that prefix.
+    // Nodes are interned by their tree, so two nodes of the same tree are the same address exactly
+    // when they are the same node.
+    class address_node
+    {
+    private:
+
+        const address_node* parent_opt;
+        name_t name;
+        std::size_t depth;
+        std::size_t hash_code;
+
+    protected:
+
+        friend const address_node* get_parent_node(const address_node& node);
+        friend const name_t& get_node_name(const address_node& node);
+        friend std::size_t get_node_depth(const address_node& node);
+        friend std::size_t get_node_hash(const address_node& node);
+
+    public:
+
+        CONSTRAINT(address_node);
+
+        address_node(const address_node&) = delete;
+        address_node(address_node&&) = delete;
+        address_node& operator=(const address_node&) = delete;
+        address_node& operator=(address_node&&) = delete;
+
+        address_node() : parent_opt(), name(), depth(), hash_code() { }
+
+        address_node(const address_node& parent, const name_t& name) :
+            parent_opt(&parent),
+            name(name),
+            depth(parent.depth + 1),
+            hash_code(extend_hash(parent.hash_code, get_hash(name)))
+        { }
+    };
+
+    // Get the node of a node's parent address, or null if it is the root.
+    inline const address_node* get_parent_node(const address_node& node)
+    {
+        return node.parent_opt;
+    }
+
+    // Get the last name of a node's address.
+    inline const name_t& get_node_name(const address_node& node)
+    {
+        return node.name;
+    }
+
+    // Get the number of names in a node's address.
+    inline std::size_t get_node_depth(const address_node& node)
+    {
+        return node.depth;
+    }
+
+    // Get the hash of a node's address, which is the same as the hash of the equivalent address.
+    inline std::size_t get_node_hash(const address_node& node)
+    {
+        return node.hash_code;
+    }
+
+    // The key of a child node in its tree.
+    struct address_node_key
+    {
+        CONSTRAINT(address_node_key);
+
+        const address_node* parent;
+        name_t name;
+
+        bool operator==(const address_node_key& that) const { return parent == that.parent && name == that.name; }
+    };
+
+    struct address_node_key_hash
+    {
+        std::size_t operator()(const address_node_key& key) const
+        {
+            return extend_hash(get_node_hash(*key.parent), get_hash(key.name));
+        }
+    };
+
+    // A persistent tree of interned address nodes, rooted at the empty address.
+    //
+    // Getting a child node is a single table lookup however deep its parent is, and a prefix test
+    // is a walk up parent links comparing pointers. Nodes live as long as their tree, and are never
+    // moved, so they may be held by reference. A tree is not thread-safe.
+    class address_tree
+    {
+    private:
+
+        address_node root;
+        std::unordered_map<address_node_key, std::unique_ptr<address_node>, address_node_key_hash> nodes;
+
+    protected:
+
+        friend const address_node& get_root_node(const address_tree& tree);
+        friend const address_node& get_child_node(address_tree& tree, const address_node& parent, const name_t& name);
+        friend std::size_t get_node_count(const address_tree& tree);
+
+    public:
+
+        CONSTRAINT(address_tree);
+
+        address_tree() : root(), nodes() { }
+        address_tree(const address_tree&) = delete;
+        address_tree(address_tree&&) = delete;
+        address_tree& operator=(const address_tree&) = delete;
+        address_tree& operator=(address_tree&&) = delete;
+    };
+
+    // Get the node of the empty address.
+    inline const address_node& get_root_node(const address_tree& tree)
+    {
+        return tree.root;
+    }
+
+    // Get the node of a parent node's address with a name appended, adding it if it is new. The
+    // parent must be of the same tree.
+    inline const address_node& get_child_node(address_tree& tree, const address_node& parent, const name_t& name)
+    {
+        VAR& node_opt = tree.nodes[address_node_key{ &parent, name }];
+        if (!node_opt) node_opt = std::make_unique<address_node>(parent, name);
+        return *node_opt;
+    }
+
+    // Get the node of a parent node's address with an address appended.
+    inline const address_node& get_child_node(address_tree& tree, const address_node& parent, const address& address)
+    {
+        VAR* node = &parent;
+        for (VAL& name : get_names(address)) node = &get_child_node(tree, *node, name);
+        return *node;
+    }
+
+    // Get the node of an address.
+    inline const address_node& get_node(address_tree& tree, const address& address)
+    {
+        return get_child_node(tree, get_root_node(tree), address);
+    }
+
+    // Get the number of nodes in a tree besides its root.
+    inline std::size_t get_node_count(const address_tree& tree)
+    {
+        return tree.nodes.size();
+    }
+
+    // Query that one node's address is a prefix of another's, including being the same address.
+    // Both nodes must be of the same tree.
+    inline bool is_prefix_node(const address_node& prefix, const address_node& node)
+    {
+        if (get_node_depth(prefix) > get_node_depth(node)) return false;
+        VAR* ancestor = &node;
+        for (VAR depth = get_node_depth(node); depth != get_node_depth(prefix); --depth) ancestor = get_parent_node(*ancestor);
+        return ancestor == &prefix;
+    }
+
+    // Get the address of a node.
+    inline address get_node_address(const address_node& node)
+    {
+        inline_vector<const address_node*, 8> ancestors{};
+        for (VAR* ancestor = &node; get_parent_node(*ancestor); ancestor = get_parent_node(*ancestor)) ancestors.push_back(ancestor);
+        address_names names{};
+        names.reserve(ancestors.size());
+        for (VAR it = ancestors.end(); it != ancestors.begin();) names.push_back(get_node_name(**--it));
+        return address(std::move(names));
+    }
+}
+
+#endif
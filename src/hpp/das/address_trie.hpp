@@ -0,0 +1,185 @@
+#ifndef DAS_ADDRESS_TRIE_HPP
+#define DAS_ADDRESS_TRIE_HPP
+
+#include <cstddef>
+#include <stdexcept>
+#include <iterator>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+#include "prelude.hpp"
+#include "name.hpp"
+#include "address.hpp"
+
+namespace das
+{
+    // The name of a pattern segment that matches any single address segment.
+    inline const name_t& get_wildcard_name()
+    {
+        static const name_t wildcard_name("*");
+        return wildcard_name;
+    }
+
+    // The name of a pattern segment that matches one or more trailing address segments. It may
+    // only appear as the last segment of a pattern.
+    inline const name_t& get_wildcard_rest_name()
+    {
+        static const name_t wildcard_rest_name("**");
+        return wildcard_rest_name;
+    }
+
+    // Query that an address contains wildcard segments, and is therefore a pattern that matches
+    // other addresses rather than the address of a single event.
+    inline bool is_address_pattern(const address& address)
+    {
+        for (VAL& name : get_names(address))
+            if (name == get_wildcard_name() || name == get_wildcard_rest_name())
+                return true;
+        return false;
+    }
+
+    // A trie of values indexed by address patterns, where each level of the trie corresponds to a
+    // segment of an address. Matching an address against every pattern in the trie is a single
+    // walk down the address' segments, so its cost is proportional to the depth of the address
+    // rather than to the number of patterns.
+    template<typename V>
+    class address_trie
+    {
+    private:
+
+        std::unique_ptr<V> value_opt;
+        std::unordered_map<name_t, std::unique_ptr<address_trie>> children;
+        std::unique_ptr<address_trie> wildcard_child_opt;
+        std::unique_ptr<address_trie> wildcard_rest_child_opt;
+
+    protected:
+
+        template<typename A>
+        friend A& get_or_add_trie_value(address_trie<A>& trie, const address& pattern);
+
+        template<typename A>
+        friend A* try_get_trie_value(address_trie<A>& trie, const address& pattern);
+
+        template<typename A>
+        friend bool remove_trie_value_from(address_trie<A>& trie, const address_names& names, std::size_t index);
+
+        template<typename A, typename F>
+        friend bool match_trie_values_from(const address_trie<A>& trie, const address_names& names, std::size_t index, const F& visit);
+
+    public:
+
+        CONSTRAINT(address_trie);
+
+        address_trie() = default;
+        address_trie(const address_trie&) = delete;
+        address_trie(address_trie&&) = default;
+        address_trie& operator=(const address_trie&) = delete;
+        address_trie& operator=(address_trie&&) = default;
+    };
+
+    // Get the value stored at exactly the given pattern, adding a default value if there is none.
+    template<typename V>
+    V& get_or_add_trie_value(address_trie<V>& trie, const address& pattern)
+    {
+        VAR* node = &trie;
+        VAL& names = get_names(pattern);
+        for (VAR it = std::begin(names); it != std::end(names); ++it)
+        {
+            VAL& name = *it;
+            if (name == get_wildcard_rest_name())
+            {
+                if (std::next(it) != std::end(names)) throw std::logic_error("Wildcard '**' must be the last segment of a pattern.");
+                if (!node->wildcard_rest_child_opt) node->wildcard_rest_child_opt = std::make_unique<address_trie<V>>();
+                node = node->wildcard_rest_child_opt.get();
+            }
+            else if (name == get_wildcard_name())
+            {
+                if (!node->wildcard_child_opt) node->wildcard_child_opt = std::make_unique<address_trie<V>>();
+                node = node->wildcard_child_opt.get();
+            }
+            else
+            {
+                VAR& child_opt = node->children[name];
+                if (!child_opt) child_opt = std::make_unique<address_trie<V>>();
+                node = child_opt.get();
+            }
+        }
+        if (!node->value_opt) node->value_opt = std::make_unique<V>();
+        return *node->value_opt;
+    }
+
+    // Try to get the value stored at exactly the given pattern. Wildcards in the pattern are not
+    // expanded, so this finds only what was added with the very same pattern.
+    template<typename V>
+    V* try_get_trie_value(address_trie<V>& trie, const address& pattern)
+    {
+        VAR* node = &trie;
+        for (VAL& name : get_names(pattern))
+        {
+            if (name == get_wildcard_rest_name()) node = node->wildcard_rest_child_opt.get();
+            else if (name == get_wildcard_name()) node = node->wildcard_child_opt.get();
+            else
+            {
+                VAL child_opt = node->children.find(name);
+                node = child_opt != std::end(node->children) ? child_opt->second.get() : nullptr;
+            }
+            if (!node) return nullptr;
+        }
+        return node->value_opt.get();
+    }
+
+    // Remove the value stored at exactly the given names from the given index onward, pruning the
+    // nodes it leaves empty, and returning whether the trie itself was left empty.
+    template<typename V>
+    bool remove_trie_value_from(address_trie<V>& trie, const address_names& names, std::size_t index)
+    {
+        if (index == names.size()) trie.value_opt.reset();
+        else
+        {
+            VAL& name = names[index];
+            if (name == get_wildcard_rest_name() || name == get_wildcard_name())
+            {
+                VAR& child_opt = name == get_wildcard_rest_name() ? trie.wildcard_rest_child_opt : trie.wildcard_child_opt;
+                if (child_opt && remove_trie_value_from(*child_opt, names, succ(index))) child_opt.reset();
+            }
+            else
+            {
+                VAL child_opt = trie.children.find(name);
+                if (child_opt != std::end(trie.children) && remove_trie_value_from(*child_opt->second, names, succ(index))) trie.children.erase(child_opt);
+            }
+        }
+        return !trie.value_opt && trie.children.empty() && !trie.wildcard_child_opt && !trie.wildcard_rest_child_opt;
+    }
+
+    // Remove the value stored at exactly the given pattern, if any, along with the nodes of the
+    // trie that only led to it.
+    template<typename V>
+    void remove_trie_value(address_trie<V>& trie, const address& pattern)
+    {
+        remove_trie_value_from(trie, get_names(pattern), 0z);
+    }
+
+    // Visit the values of the patterns that match the given names from the given index onward.
+    template<typename V, typename F>
+    bool match_trie_values_from(const address_trie<V>& trie, const address_names& names, std::size_t index, const F& visit)
+    {
+        if (index == names.size()) return !trie.value_opt || visit(*trie.value_opt);
+        VAL child_opt = trie.children.find(names[index]);
+        if (child_opt != std::end(trie.children) && !match_trie_values_from(*child_opt->second, names, succ(index), visit)) return false;
+        if (trie.wildcard_child_opt && !match_trie_values_from(*trie.wildcard_child_opt, names, succ(index), visit)) return false;
+        if (trie.wildcard_rest_child_opt && trie.wildcard_rest_child_opt->value_opt) return visit(*trie.wildcard_rest_child_opt->value_opt);
+        return true;
+    }
+
+    // Visit the value of every pattern in the trie that matches the given address, stopping early
+    // when the visitor returns false. At each segment, literal names are visited before '*', which
+    // is visited before '**'. Returns false if visitation was stopped early.
+    template<typename V, typename F>
+    bool match_trie_values(const address_trie<V>& trie, const address& address, const F& visit)
+    {
+        return match_trie_values_from(trie, get_names(address), 0z, visit);
+    }
+}
+
+#endif
@@ -2,33 +2,76 @@
 #define DAS_CASTABLE_HPP
 
 #include <cstddef>
-#include <typeinfo>
-#include <typeindex>
 #include <memory>
+#include <stdexcept>
 
 #include "prelude.hpp"
 
 namespace das
 {
+    // The greatest depth of castable inheritance, counting castable itself as depth 0.
+    constexpr std::size_t castable_depth_max = 16;
+
+    // A key that identifies a castable type. Like event_type_key, it is just a pointer.
+    using castable_type_key = const void*;
+
+    // Get the key that identifies castable type T.
+    template<typename T>
+    castable_type_key get_castable_type_key()
+    {
+        static const char key = 0;
+        return &key;
+    }
+
+    // The display of a castable type, being the keys of the type and its ancestors indexed by
+    // their depth, in the manner of Cohen's display. Entries past the type's own depth are null.
+    struct castable_display
+    {
+        CONSTRAINT(castable_display);
+
+        castable_type_key keys[castable_depth_max];
+    };
+
+    // Make the display of a type at the given depth from the display of its parent type.
+    inline castable_display extend_castable_display(const castable_display& parent, std::size_t depth, castable_type_key key)
+    {
+        VAR display = parent;
+        display.keys[depth] = key;
+        return display;
+    }
+
+    class castable;
+
+    // Grants the cast functions access to the static depth and display of each castable type.
+    struct castable_access
+    {
+        template<typename T>
+        static constexpr std::size_t get_castable_depth() { return T::castable_depth; }
+
+        static const castable_display& get_castable_display(const castable& castable);
+    };
+
     // A mixin for enabling down casts without resorting to inefficient dynamic_casts.
     // Does NOT work with multiple implementation inheritance, so you must NOT use multiple
     // implementation inheritance with any type that inherits from das::castable.
+    //
+    // Each castable type knows its depth at compile time, and its display at run time, so a cast
+    // is one virtual call and one indexed compare however deep the type's inheritance is, and a
+    // failed cast costs the same as a successful one.
     class castable
     {
     protected:
 
-        virtual const void* try_cast_const(std::type_index type_index) const
-        {
-            if (type_index == std::type_index(typeid(castable))) return static_cast<const void*>(this);
-            return nullptr;
-        }
+        static constexpr std::size_t castable_depth = 0;
 
-        virtual void* try_cast(std::type_index type_index)
+        virtual const castable_display& get_castable_display() const
         {
-            if (type_index == std::type_index(typeid(castable))) return static_cast<void*>(this);
-            return nullptr;
+            static const castable_display display = extend_castable_display(castable_display{}, 0, get_castable_type_key<castable>());
+            return display;
         }
 
+        friend struct castable_access;
+
         template<typename T>
         friend const T* try_cast_const(const castable& castable);
 
@@ -48,39 +91,49 @@ namespace das
         virtual ~castable() = default;
     };
 
+    // Query that a display is of castable type T or of a type derived from it.
+    template<typename T>
+    bool is_castable_display_of(const castable_display& display)
+    {
+        return display.keys[castable_access::get_castable_depth<T>()] == get_castable_type_key<T>();
+    }
+
+    inline const castable_display& castable_access::get_castable_display(const castable& castable)
+    {
+        return castable.get_castable_display();
+    }
+
     template<typename T>
     const T* try_cast_const(const castable& castable)
     {
-        VAL type_index = std::type_index(typeid(T));
-        VAL* t_opt(static_cast<const T*>(castable.try_cast_const(type_index)));
-        return t_opt;
+        if (!is_castable_display_of<T>(castable.get_castable_display())) return nullptr;
+        return static_cast<const T*>(&castable);
     }
 
     template<typename T>
     T* try_cast(castable& castable)
     {
-        VAL type_index = std::type_index(typeid(T));
-        VAR* t_opt(static_cast<T*>(castable.try_cast(type_index)));
-        return t_opt;
+        if (!is_castable_display_of<T>(castable.get_castable_display())) return nullptr;
+        return static_cast<T*>(&castable);
     }
 
     template<typename T>
     const T& cast_const(const castable& castable)
     {
-        return **try_cast_const<T>(castable);
+        return *try_cast_const<T>(castable);
     }
 
     template<typename T>
     T& cast(castable& castable)
     {
-        return **try_cast<T>(castable);
+        return *try_cast<T>(castable);
     }
 
     template<typename U, typename T>
     std::shared_ptr<U> try_cast_shared(const std::shared_ptr<T>& source)
     {
         VAR u_opt = try_cast<U>(*source);
-        if (u_opt) return std::shared_ptr<U>(source, *u_opt);
+        if (u_opt) return std::shared_ptr<U>(source, u_opt);
         return std::shared_ptr<U>();
     }
 
@@ -107,16 +160,14 @@ namespace das
 
 #define ENABLE_CAST(t, s) \
     \
-    const void* try_cast_const(std::type_index type_index) const override \
-    { \
-        if (type_index == std::type_index(typeid(t))) return static_cast<const void*>(this); \
-        return s::try_cast_const(type_index); \
-    } \
+    static constexpr std::size_t castable_depth = s::castable_depth + 1; \
+    static_assert(castable_depth < ::das::castable_depth_max, "Castable inheritance is too deep."); \
+    friend struct ::das::castable_access; \
     \
-    void* try_cast(std::type_index type_index) override \
+    const ::das::castable_display& get_castable_display() const override \
     { \
-        if (type_index == std::type_index(typeid(t))) return static_cast<void*>(this); \
-        return s::try_cast(type_index); \
+        static const ::das::castable_display display = ::das::extend_castable_display(s::get_castable_display(), castable_depth, ::das::get_castable_type_key<t>()); \
+        return display; \
     } \
     struct enable_cast_macro_end
 
@@ -0,0 +1,249 @@
+#ifndef DAS_CASTABLE_POOL_HPP
+#define DAS_CASTABLE_POOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <memory>
+#include <utility>
+#include <algorithm>
+#include <vector>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+
+#include "prelude.hpp"
+#include "castable.hpp"
+
+namespace das
+{
+    // A stable handle to an object of a castable pool. A handle to a removed object is detected as
+    // such, even once its slot holds another object.
+    struct castable_handle
+    {
+        CONSTRAINT(castable_handle);
+
+        std::uint32_t partition_index;
+        std::uint32_t slot_index;
+        std::uint32_t generation;
+    };
+
+    class castable_pool;
+
+    // The objects of a single concrete type in a castable pool, stored contiguously in chunks that
+    // never move. Slots freed by removal are reused before the partition grows.
+    class castable_partition
+    {
+    private:
+
+        static constexpr std::size_t chunk_size = 256;
+
+        const castable_display* display_opt;
+        std::size_t object_size;
+        std::ptrdiff_t castable_offset;
+        void(*destroy)(void* object);
+        std::vector<std::unique_ptr<unsigned char[]>> chunks;
+        std::vector<std::uint32_t> generations;
+        std::vector<unsigned char> occupied;
+        std::vector<std::uint32_t> slots_free;
+
+    protected:
+
+        friend void* get_partition_object(castable_partition& partition, std::size_t slot_index);
+        friend castable& get_partition_castable(castable_partition& partition, std::size_t slot_index);
+
+        template<typename T, typename... Args>
+        friend castable_handle add_castable(castable_pool& pool, Args&&... args);
+
+        friend void remove_castable(castable_pool& pool, castable_handle handle);
+        friend castable* try_get_castable(castable_pool& pool, castable_handle handle);
+
+        template<typename T, typename F>
+        friend void for_each(castable_pool& pool, const F& fn);
+
+    public:
+
+        CONSTRAINT(castable_partition);
+
+        castable_partition(const castable_partition&) = delete;
+        castable_partition(castable_partition&&) = delete;
+        castable_partition& operator=(const castable_partition&) = delete;
+        castable_partition& operator=(castable_partition&&) = delete;
+
+        castable_partition(std::size_t object_size, void(*destroy)(void* object)) :
+            display_opt(),
+            object_size(object_size),
+            castable_offset(),
+            destroy(destroy),
+            chunks(),
+            generations(),
+            occupied(),
+            slots_free()
+        { }
+
+        ~castable_partition()
+        {
+            for (std::size_t i = 0; i < occupied.size(); ++i)
+                if (occupied[i]) destroy(get_partition_object(*this, i));
+        }
+    };
+
+    // Get the storage of a slot of a partition.
+    inline void* get_partition_object(castable_partition& partition, std::size_t slot_index)
+    {
+        return partition.chunks[slot_index / castable_partition::chunk_size].get() + slot_index % castable_partition::chunk_size * partition.object_size;
+    }
+
+    // Get the object in an occupied slot of a partition as a castable, without a virtual call.
+    inline castable& get_partition_castable(castable_partition& partition, std::size_t slot_index)
+    {
+        return *reinterpret_cast<castable*>(static_cast<unsigned char*>(get_partition_object(partition, slot_index)) + partition.castable_offset);
+    }
+
+    // A container of castable objects of any types, where each concrete type is stored
+    // contiguously in its own partition.
+    //
+    // Iterating the objects of a type visits only the partitions of that type and the types
+    // derived from it, each in the order of its storage, and checks the type just once per
+    // partition rather than once per object. Objects never move, and are addressed by stable
+    // handles. A pool is not thread-safe.
+    class castable_pool
+    {
+    private:
+
+        std::vector<std::unique_ptr<castable_partition>> partitions;
+        std::unordered_map<castable_type_key, std::uint32_t> partition_indices;
+
+    protected:
+
+        template<typename T, typename... Args>
+        friend castable_handle add_castable(castable_pool& pool, Args&&... args);
+
+        friend void remove_castable(castable_pool& pool, castable_handle handle);
+        friend castable* try_get_castable(castable_pool& pool, castable_handle handle);
+
+        template<typename T, typename F>
+        friend void for_each(castable_pool& pool, const F& fn);
+
+    public:
+
+        CONSTRAINT(castable_pool);
+
+        castable_pool() : partitions(), partition_indices() { }
+        castable_pool(const castable_pool&) = delete;
+        castable_pool(castable_pool&&) = default;
+        castable_pool& operator=(const castable_pool&) = delete;
+        castable_pool& operator=(castable_pool&&) = default;
+    };
+
+    // Construct an object of concrete castable type T in a pool.
+    template<typename T, typename... Args>
+    castable_handle add_castable(castable_pool& pool, Args&&... args)
+    {
+        static_assert(std::is_base_of<castable, T>::value, "Type must be castable.");
+        static_assert(alignof(T) <= alignof(std::max_align_t), "Type must not be over-aligned.");
+
+        // find or add the partition of T, indexing a new partition only once it exists
+        VAL type_key = get_castable_type_key<T>();
+        VAR partition_index_opt = pool.partition_indices.find(type_key);
+        if (partition_index_opt == std::end(pool.partition_indices))
+        {
+            pool.partitions.push_back(std::make_unique<castable_partition>(sizeof(T), [](void* object) { static_cast<T*>(object)->~T(); }));
+            partition_index_opt = pool.partition_indices.emplace(type_key, static_cast<std::uint32_t>(pool.partitions.size() - 1)).first;
+        }
+        VAL partition_index = partition_index_opt->second;
+        VAR& partition = *pool.partitions[partition_index];
+
+        // find or add a free slot, which is freed again should T's constructor throw
+        std::uint32_t slot_index = 0;
+        if (!partition.slots_free.empty())
+        {
+            slot_index = partition.slots_free.back();
+            partition.slots_free.pop_back();
+        }
+        else
+        {
+            slot_index = static_cast<std::uint32_t>(partition.generations.size());
+            if (slot_index % castable_partition::chunk_size == 0)
+            {
+                std::unique_ptr<unsigned char[]> chunk(new unsigned char[castable_partition::chunk_size * sizeof(T)]);
+                partition.chunks.push_back(std::move(chunk));
+            }
+            partition.generations.push_back(0);
+            partition.occupied.push_back(false);
+        }
+
+        // construct the object, learning its partition's display and castable offset from the
+        // first one constructed
+        T* object = nullptr;
+        try
+        {
+            object = ::new (get_partition_object(partition, slot_index)) T(std::forward<Args>(args)...);
+        }
+        catch (...)
+        {
+            partition.slots_free.push_back(slot_index);
+            throw;
+        }
+        if (!partition.display_opt)
+        {
+            VAL& object_castable = static_cast<castable&>(*object);
+            partition.display_opt = &castable_access::get_castable_display(object_castable);
+            partition.castable_offset = reinterpret_cast<const unsigned char*>(&object_castable) - reinterpret_cast<const unsigned char*>(object);
+        }
+        partition.occupied[slot_index] = true;
+        return castable_handle{ partition_index, slot_index, partition.generations[slot_index] };
+    }
+
+    // Try to get the object of a handle, or null if it has been removed.
+    inline castable* try_get_castable(castable_pool& pool, castable_handle handle)
+    {
+        if (handle.partition_index >= pool.partitions.size()) return nullptr;
+        VAR& partition = *pool.partitions[handle.partition_index];
+        if (handle.slot_index >= partition.generations.size() || partition.generations[handle.slot_index] != handle.generation || !partition.occupied[handle.slot_index]) return nullptr;
+        return &get_partition_castable(partition, handle.slot_index);
+    }
+
+    // Try to get the object of a handle as a T, or null if it has been removed or is not a T.
+    template<typename T>
+    T* try_get_castable(castable_pool& pool, castable_handle handle)
+    {
+        VAR* castable_opt = try_get_castable(pool, handle);
+        return castable_opt ? try_cast<T>(*castable_opt) : nullptr;
+    }
+
+    // Destroy the object of a handle, if it has not already been removed.
+    inline void remove_castable(castable_pool& pool, castable_handle handle)
+    {
+        if (!try_get_castable(pool, handle)) return;
+        VAR& partition = *pool.partitions[handle.partition_index];
+        partition.destroy(get_partition_object(partition, handle.slot_index));
+        partition.occupied[handle.slot_index] = false;
+        ++partition.generations[handle.slot_index];
+        partition.slots_free.push_back(handle.slot_index);
+    }
+
+    // Visit every object in a pool that is a T or of a type derived from T.
+    template<typename T, typename F>
+    void for_each(castable_pool& pool, const F& fn)
+    {
+        // partitions are indexed rather than iterated since the visitor may add to the pool
+        for (std::size_t partition_index = 0; partition_index < pool.partitions.size(); ++partition_index)
+        {
+            VAR& partition = *pool.partitions[partition_index];
+            if (!partition.display_opt || !is_castable_display_of<T>(*partition.display_opt)) continue;
+            // walk each chunk's objects in storage order, skipping free slots
+            VAL slot_count = partition.occupied.size();
+            for (std::size_t slot_begin = 0; slot_begin < slot_count; slot_begin += castable_partition::chunk_size)
+            {
+                VAR* object = partition.chunks[slot_begin / castable_partition::chunk_size].get() + partition.castable_offset;
+                VAL slot_end = std::min(slot_count, slot_begin + castable_partition::chunk_size);
+                for (VAR slot_index = slot_begin; slot_index != slot_end; ++slot_index, object += partition.object_size)
+                    if (partition.occupied[slot_index])
+                        fn(static_cast<T&>(*reinterpret_cast<castable*>(object)));
+            }
+        }
+    }
+}
+
+#endif
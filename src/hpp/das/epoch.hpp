@@ -0,0 +1,163 @@
+#ifndef DAS_EPOCH_HPP
+#define DAS_EPOCH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <array>
+#include <thread>
+
+#include "prelude.hpp"
+
+namespace das
+{
+    // The process-wide domain of epoch-based reclamation.
+    //
+    // Readers enter the domain with an epoch_guard around their reads of shared data, taking no
+    // locks. Writers unlink the data they replace, then retire it at the epoch returned by
+    // advance_epoch, and may reclaim it once get_epoch_reclaimable shows that every reader that
+    // could have seen it has since left the domain.
+    class epoch_domain
+    {
+    private:
+
+        struct alignas(64) epoch_slot
+        {
+            std::atomic<std::uint64_t> epoch;
+            std::atomic<bool> claimed;
+        };
+
+        static constexpr std::size_t slot_count = 256;
+
+        std::atomic<std::uint64_t> epoch;
+        std::array<epoch_slot, slot_count> slots;
+
+    protected:
+
+        friend class epoch_reader;
+        friend class epoch_guard;
+        friend std::uint64_t advance_epoch();
+        friend bool get_epoch_reclaimable(std::uint64_t retired_epoch);
+
+    public:
+
+        CONSTRAINT(epoch_domain);
+
+        epoch_domain() : epoch(1)
+        {
+            for (VAR& slot : slots)
+            {
+                slot.epoch.store(0);
+                slot.claimed.store(false);
+            }
+        }
+
+        epoch_domain(const epoch_domain&) = delete;
+        epoch_domain(epoch_domain&&) = delete;
+        epoch_domain& operator=(const epoch_domain&) = delete;
+        epoch_domain& operator=(epoch_domain&&) = delete;
+    };
+
+    // Get the process-wide epoch domain.
+    inline epoch_domain& get_epoch_domain()
+    {
+        static epoch_domain domain;
+        return domain;
+    }
+
+    // Advance the epoch, returning the epoch at which anything unlinked before the call is to be
+    // retired.
+    inline std::uint64_t advance_epoch()
+    {
+        return get_epoch_domain().epoch.fetch_add(1);
+    }
+
+    // Query that the data retired at the given epoch can no longer be seen by any reader.
+    inline bool get_epoch_reclaimable(std::uint64_t retired_epoch)
+    {
+        for (VAL& slot : get_epoch_domain().slots)
+        {
+            VAL reader_epoch = slot.epoch.load();
+            if (reader_epoch != 0 && reader_epoch <= retired_epoch) return false;
+        }
+        return true;
+    }
+
+    // The calling thread's participation in the epoch domain. A thread claims one of the domain's
+    // slots when it first reads, and gives it back when the thread exits.
+    class epoch_reader
+    {
+    private:
+
+        epoch_domain::epoch_slot* slot_opt;
+        std::size_t depth;
+
+    protected:
+
+        friend class epoch_guard;
+
+    public:
+
+        CONSTRAINT(epoch_reader);
+
+        epoch_reader() : slot_opt(nullptr), depth(0) { }
+        epoch_reader(const epoch_reader&) = delete;
+        epoch_reader(epoch_reader&&) = delete;
+        epoch_reader& operator=(const epoch_reader&) = delete;
+        epoch_reader& operator=(epoch_reader&&) = delete;
+
+        ~epoch_reader()
+        {
+            if (slot_opt) slot_opt->claimed.store(false);
+        }
+    };
+
+    // Get the calling thread's participation in the epoch domain.
+    inline epoch_reader& get_epoch_reader()
+    {
+        thread_local epoch_reader reader;
+        return reader;
+    }
+
+    // Marks the extent of a read in the epoch domain by the calling thread. Guards may nest, in
+    // which case only the outermost guard enters and leaves the domain.
+    class epoch_guard
+    {
+    private:
+
+        epoch_reader& reader;
+
+    public:
+
+        epoch_guard(const epoch_guard&) = delete;
+        epoch_guard(epoch_guard&&) = delete;
+        epoch_guard& operator=(const epoch_guard&) = delete;
+        epoch_guard& operator=(epoch_guard&&) = delete;
+
+        epoch_guard() : reader(get_epoch_reader())
+        {
+            if (reader.depth++ != 0) return;
+            VAR& domain = get_epoch_domain();
+            while (!reader.slot_opt)
+            {
+                for (VAR& slot : domain.slots)
+                {
+                    if (!slot.claimed.load(std::memory_order_relaxed) && !slot.claimed.exchange(true))
+                    {
+                        reader.slot_opt = &slot;
+                        break;
+                    }
+                }
+                if (!reader.slot_opt) std::this_thread::yield();
+            }
+            reader.slot_opt->epoch.store(domain.epoch.load());
+        }
+
+        ~epoch_guard()
+        {
+            if (--reader.depth == 0) reader.slot_opt->epoch.store(0, std::memory_order_release);
+        }
+    };
+}
+
+#endif
@@ -21,7 +21,7 @@ namespace das
         using reify = event<A>;
 
         const T data;
-        const address address;
+        const das::address address;
         const std::shared_ptr<addressable> subscriber; // TODO: may be necessary to genericize subscriber
         const std::shared_ptr<addressable> publisher;
 
@@ -41,6 +41,46 @@ namespace das
             subscriber(subscriber),
             publisher(publisher) { }
     };
+
+    // A view of an event that borrows rather than copies its parts, which is what handlers are
+    // given so that publishing to many subscribers copies nothing per subscriber. The view and
+    // what it borrows live only as long as the handler call, so a handler that needs to keep the
+    // event must convert it to an event.
+    template<typename T>
+    struct event_view
+    {
+        CONSTRAINT(event_view);
+
+        template<typename A>
+        using reify = event_view<A>;
+
+        const T& data;
+        const das::address& address;
+        const std::shared_ptr<addressable>& subscriber;
+        const std::shared_ptr<addressable>& publisher;
+
+        event_view() = delete;
+        event_view(const event_view& that) = default;
+        event_view(event_view&& that) = default;
+        event_view& operator=(const event_view&) = delete;
+        event_view& operator=(event_view&&) = delete;
+
+        event_view(
+            const T& data,
+            const das::address& address,
+            const std::shared_ptr<addressable>& subscriber,
+            const std::shared_ptr<addressable>& publisher) :
+            data(data),
+            address(address),
+            subscriber(subscriber),
+            publisher(publisher) { }
+
+        // Copy the viewed event.
+        operator event<T>() const
+        {
+            return event<T>(data, address, subscriber, publisher);
+        }
+    };
 }
 
 #endif
@@ -0,0 +1,170 @@
+#ifndef DAS_EVENT_AWAITER_HPP
+#define DAS_EVENT_AWAITER_HPP
+
+#if defined(__cpp_impl_coroutine)
+
+#include <cstddef>
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <utility>
+
+#include "prelude.hpp"
+#include "addressable.hpp"
+#include "address.hpp"
+#include "event.hpp"
+#include "subscription.hpp"
+#include "eventable.hpp"
+
+namespace das
+{
+    // Awaits the next event of type T published to an address or address pattern.
+    //
+    // A suspended coroutine is parked on its channel's intrusive waiter list by the awaiter itself,
+    // which lives in the coroutine's frame, so awaiting neither allocates a handler nor touches
+    // the program's subscriptions beyond adding the channel the first time it is awaited. The
+    // coroutine is resumed from within the publish, and is given a view of the event that is valid
+    // only until the coroutine next suspends or returns. As the event has no subscriber, the view's
+    // subscriber is null.
+    //
+    // Destroying a suspended coroutine unlinks its awaiter from the waiter list. A coroutine
+    // suspended when the program is destroyed is never resumed, but is still freed by destroying
+    // it, such as by destroying its event_task.
+    template<typename T, typename P>
+    class event_awaiter
+    {
+    private:
+
+        P& program;
+        const das::address address;
+        event_waiter waiter;
+
+    public:
+
+        CONSTRAINT(event_awaiter);
+
+        event_awaiter() = delete;
+        event_awaiter(const event_awaiter&) = delete;
+        event_awaiter(event_awaiter&&) = delete;
+        event_awaiter& operator=(const event_awaiter&) = delete;
+        event_awaiter& operator=(event_awaiter&&) = delete;
+
+        event_awaiter(P& program, const das::address& address) :
+            program(program),
+            address(address),
+            waiter{ nullptr, nullptr, nullptr, nullptr, nullptr, nullptr } { }
+
+        ~event_awaiter()
+        {
+            if (waiter.list_opt) unlink_event_waiter(waiter);
+        }
+
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            VAR& channel = get_or_add_channel(program, channel_key(address, get_event_type_key<T>()));
+            waiter.resume = [](void* context) { std::coroutine_handle<>::from_address(context).resume(); };
+            waiter.context = handle.address();
+            link_event_waiter(channel.waiters, waiter);
+        }
+
+        event_view<T> await_resume() const noexcept
+        {
+            return *static_cast<const event_view<T>*>(waiter.event_opt);
+        }
+    };
+
+    // Await the next event of type T published to an address or address pattern.
+    template<typename T, typename P>
+    event_awaiter<T, P> next_event(P& program, const address& address)
+    {
+        CONSTRAIN(P, eventable);
+        return event_awaiter<T, P>(program, address);
+    }
+
+    // A coroutine that reacts to events in a sequence of steps. It starts running as soon as it is
+    // called, and is owned by the task it returns, so it must be kept for as long as the coroutine
+    // is to run. Destroying the task destroys the coroutine wherever it is suspended, which also
+    // makes it safe for a task to outlive its program.
+    //
+    // An exception that escapes the coroutine is caught and kept by its task, finishing the
+    // coroutine, rather than unwinding the publisher that resumed it. See get_task_exception.
+    class [[nodiscard]] event_task
+    {
+    public:
+
+        class promise_type
+        {
+        private:
+
+            std::exception_ptr exception_opt;
+
+        protected:
+
+            friend std::exception_ptr get_task_exception(const event_task& task);
+
+        public:
+
+            promise_type() : exception_opt() { }
+            event_task get_return_object() noexcept { return event_task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+            std::suspend_never initial_suspend() noexcept { return std::suspend_never{}; }
+            std::suspend_always final_suspend() noexcept { return std::suspend_always{}; }
+            void return_void() noexcept { }
+            void unhandled_exception() noexcept { exception_opt = std::current_exception(); }
+        };
+
+    private:
+
+        std::coroutine_handle<promise_type> handle_opt;
+
+        explicit event_task(std::coroutine_handle<promise_type> handle) : handle_opt(handle) { }
+
+    protected:
+
+        friend bool is_task_done(const event_task& task);
+        friend std::exception_ptr get_task_exception(const event_task& task);
+
+    public:
+
+        CONSTRAINT(event_task);
+
+        event_task() : handle_opt() { }
+        event_task(const event_task&) = delete;
+        event_task(event_task&& that_mvb) noexcept : handle_opt(std::exchange(that_mvb.handle_opt, nullptr)) { }
+        event_task& operator=(const event_task&) = delete;
+
+        event_task& operator=(event_task&& that_mvb) noexcept
+        {
+            if (this == &that_mvb) return *this;
+            if (handle_opt) handle_opt.destroy();
+            handle_opt = std::exchange(that_mvb.handle_opt, nullptr);
+            return *this;
+        }
+
+        ~event_task()
+        {
+            if (handle_opt) handle_opt.destroy();
+        }
+    };
+
+    // Query that a task's coroutine has finished, whether by returning or by throwing. An empty
+    // task counts as finished.
+    inline bool is_task_done(const event_task& task)
+    {
+        return !task.handle_opt || task.handle_opt.done();
+    }
+
+    // Get the exception that escaped a task's coroutine, or null if none did.
+    inline std::exception_ptr get_task_exception(const event_task& task)
+    {
+        return task.handle_opt ? task.handle_opt.promise().exception_opt : nullptr;
+    }
+}
+
+#endif
+
+#endif
@@ -0,0 +1,453 @@
+#ifndef DAS_EVENT_BUS_HPP
+#define DAS_EVENT_BUS_HPP
+
+#if !defined(_WIN32)
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <atomic>
+#include <string>
+#include <memory>
+#include <vector>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "prelude.hpp"
+#include "name.hpp"
+#include "addressable.hpp"
+#include "address.hpp"
+#include "eventable.hpp"
+#include "event_log.hpp"
+
+namespace das
+{
+    // The layout of the head of a shared event ring, followed in memory by the ring's records. The
+    // write and read positions only ever increase, and sit on cache lines of their own so that the
+    // writer and reader do not contend.
+    struct shared_event_ring_head
+    {
+        std::atomic<std::uint64_t> magic;
+        std::uint64_t capacity;
+        alignas(64) std::atomic<std::uint64_t> write_position;
+        alignas(64) std::atomic<std::uint64_t> read_position;
+    };
+
+    // The header of a record in a shared event ring, followed by the record's address and then its
+    // payload, each padded to a multiple of 16 bytes. A record with a tag of zero pads the ring to
+    // its end.
+    struct shared_event_record_header
+    {
+        std::uint64_t tag;
+        std::uint32_t address_size;
+        std::uint32_t payload_size;
+    };
+
+    // A single-producer, single-consumer ring of events in POSIX shared memory, through which one
+    // process sends events to another on the same host without either taking a lock.
+    //
+    // The receiving process creates the ring, which it unlinks when destroyed, and the sending
+    // process opens it by name. To have several senders, give each its own ring.
+    class shared_event_ring
+    {
+    private:
+
+        static constexpr std::uint64_t ring_magic = 0x31474e4952534144ull; // "DASRING1"
+
+        std::string name;
+        bool owner;
+        std::size_t mapping_size;
+        shared_event_ring_head* head;
+        unsigned char* records;
+        std::size_t records_dropped;
+
+    protected:
+
+        template<typename F>
+        friend bool try_write_shared_event(shared_event_ring& ring, std::uint64_t tag, const address& event_address, std::size_t payload_size, const F& write_payload);
+
+        template<typename F>
+        friend std::size_t read_shared_events(shared_event_ring& ring, const F& read_event);
+
+        friend std::size_t get_dropped_records(const shared_event_ring& ring);
+
+    public:
+
+        CONSTRAINT(shared_event_ring);
+
+        shared_event_ring(const shared_event_ring&) = delete;
+        shared_event_ring(shared_event_ring&&) = delete;
+        shared_event_ring& operator=(const shared_event_ring&) = delete;
+        shared_event_ring& operator=(shared_event_ring&&) = delete;
+
+        // Create a ring with the given capacity in bytes, which must be a power of two.
+        shared_event_ring(const std::string& name, std::size_t capacity) :
+            name(name), owner(true), mapping_size(sizeof(shared_event_ring_head) + capacity), head(), records(), records_dropped()
+        {
+            if (capacity < 256 || (capacity & (capacity - 1)) != 0) throw std::invalid_argument("Shared event ring capacity must be a power of two of at least 256.");
+            VAL file = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+            if (file < 0) throw std::runtime_error("Could not create shared memory '" + name + "'.");
+            VAR* mapping = ftruncate(file, static_cast<off_t>(mapping_size)) == 0 ? mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0) : MAP_FAILED;
+            close(file);
+            if (mapping == MAP_FAILED) { shm_unlink(name.c_str()); throw std::runtime_error("Could not map shared memory '" + name + "'."); }
+            head = new (mapping) shared_event_ring_head();
+            records = static_cast<unsigned char*>(mapping) + sizeof(shared_event_ring_head);
+            head->capacity = capacity;
+            head->write_position.store(0);
+            head->read_position.store(0);
+            head->magic.store(ring_magic, std::memory_order_release);
+        }
+
+        // Open a ring created by another process.
+        explicit shared_event_ring(const std::string& name) :
+            name(name), owner(false), mapping_size(), head(), records(), records_dropped()
+        {
+            VAL file = shm_open(name.c_str(), O_RDWR, 0600);
+            if (file < 0) throw std::runtime_error("Could not open shared memory '" + name + "'.");
+            struct stat file_stat;
+            VAR* mapping = fstat(file, &file_stat) == 0 && static_cast<std::size_t>(file_stat.st_size) > sizeof(shared_event_ring_head) ?
+                mmap(nullptr, static_cast<std::size_t>(file_stat.st_size), PROT_READ | PROT_WRITE, MAP_SHARED, file, 0) :
+                MAP_FAILED;
+            close(file);
+            if (mapping == MAP_FAILED) throw std::runtime_error("Could not map shared memory '" + name + "'.");
+            mapping_size = static_cast<std::size_t>(file_stat.st_size);
+            head = static_cast<shared_event_ring_head*>(mapping);
+            records = static_cast<unsigned char*>(mapping) + sizeof(shared_event_ring_head);
+            if (head->magic.load(std::memory_order_acquire) != ring_magic || sizeof(shared_event_ring_head) + head->capacity != mapping_size)
+            {
+                munmap(mapping, mapping_size);
+                throw std::runtime_error("Shared memory '" + name + "' is not a shared event ring.");
+            }
+        }
+
+        ~shared_event_ring()
+        {
+            munmap(head, mapping_size);
+            if (owner) shm_unlink(name.c_str());
+        }
+    };
+
+    inline std::size_t get_shared_event_size(std::size_t size)
+    {
+        return (size + 15) & ~std::size_t(15);
+    }
+
+    // Try to write an event to a ring, failing if the ring has no room for it. The payload is
+    // written straight into the ring by write_payload(unsigned char* payload).
+    template<typename F>
+    bool try_write_shared_event(shared_event_ring& ring, std::uint64_t tag, const address& event_address, std::size_t payload_size, const F& write_payload)
+    {
+        VAL& names = get_names(event_address);
+        std::size_t address_size = names.empty() ? 0 : names.size() - 1;
+        for (VAL& name : names) address_size += get_name_str(name).size();
+        VAL record_size = sizeof(shared_event_record_header) + get_shared_event_size(address_size) + get_shared_event_size(payload_size);
+        VAL capacity = ring.head->capacity;
+        if (record_size > capacity / 2) throw std::invalid_argument("Event is too large for its shared event ring.");
+
+        // pad to the end of the ring when the record would otherwise wrap
+        VAL write_position = ring.head->write_position.load(std::memory_order_relaxed);
+        VAL read_position = ring.head->read_position.load(std::memory_order_acquire);
+        VAL offset = static_cast<std::size_t>(write_position & (capacity - 1));
+        VAL padding_size = capacity - offset < record_size ? capacity - offset : 0;
+        if (capacity - (write_position - read_position) < padding_size + record_size) return false;
+        if (padding_size)
+        {
+            VAL padding = shared_event_record_header{ 0, 0, 0 };
+            std::memcpy(ring.records + offset, &padding, sizeof(padding));
+        }
+
+        VAR* record = ring.records + (offset + padding_size) % capacity;
+        VAL header = shared_event_record_header{ tag, static_cast<std::uint32_t>(address_size), static_cast<std::uint32_t>(payload_size) };
+        std::memcpy(record, &header, sizeof(header));
+        VAR* address_chars = record + sizeof(header);
+        for (VAL& name : names)
+        {
+            if (address_chars != record + sizeof(header)) *address_chars++ = '/';
+            VAL& name_str = get_name_str(name);
+            std::memcpy(address_chars, name_str.data(), name_str.size());
+            address_chars += name_str.size();
+        }
+        write_payload(record + sizeof(header) + get_shared_event_size(address_size));
+        ring.head->write_position.store(write_position + padding_size + record_size, std::memory_order_release);
+        return true;
+    }
+
+    // Read every event written to a ring so far, calling read_event(tag, address_chars,
+    // address_size, payload, payload_size) for each, and returning how many were read. The
+    // arguments are only valid during the call.
+    //
+    // As the ring's memory is shared with another process, nothing read from it is trusted. A
+    // record whose sizes would take it past the end of the ring or past what has been written is
+    // dropped along with everything after it that has been written, since where the next record
+    // starts can no longer be known.
+    template<typename F>
+    std::size_t read_shared_events(shared_event_ring& ring, const F& read_event)
+    {
+        // the ring's capacity is taken from its own mapping rather than the shared head
+        VAL capacity = static_cast<std::uint64_t>(ring.mapping_size - sizeof(shared_event_ring_head));
+        VAL write_position = ring.head->write_position.load(std::memory_order_acquire);
+        VAR read_position = ring.head->read_position.load(std::memory_order_relaxed);
+        std::size_t read = 0;
+        if (write_position - read_position > capacity)
+        {
+            ++ring.records_dropped;
+            read_position = write_position;
+        }
+        while (read_position != write_position)
+        {
+            VAL offset = read_position & (capacity - 1);
+            VAL remaining = write_position - read_position;
+            VAL* record = ring.records + offset;
+            shared_event_record_header header;
+            if (offset % 16 != 0 || remaining < sizeof(header))
+            {
+                ++ring.records_dropped;
+                read_position = write_position;
+                break;
+            }
+            std::memcpy(&header, record, sizeof(header));
+            if (header.tag == 0)
+            {
+                if (capacity - offset > remaining)
+                {
+                    ++ring.records_dropped;
+                    read_position = write_position;
+                    break;
+                }
+                read_position += capacity - offset;
+                continue;
+            }
+            VAL record_size = static_cast<std::uint64_t>(sizeof(header) + get_shared_event_size(header.address_size) + get_shared_event_size(header.payload_size));
+            if (record_size > capacity / 2 || record_size > capacity - offset || record_size > remaining)
+            {
+                ++ring.records_dropped;
+                read_position = write_position;
+                break;
+            }
+            VAL* address_chars = reinterpret_cast<const char*>(record + sizeof(header));
+            VAL* payload = record + sizeof(header) + get_shared_event_size(header.address_size);
+            read_event(header.tag, address_chars, std::size_t(header.address_size), payload, std::size_t(header.payload_size));
+            read_position += record_size;
+            ring.head->read_position.store(read_position, std::memory_order_release);
+            ++read;
+        }
+        ring.head->read_position.store(read_position, std::memory_order_release);
+        return read;
+    }
+
+    // Get how many records a ring has dropped on reading them because they were malformed, such as
+    // by a writer that corrupted the shared memory.
+    inline std::size_t get_dropped_records(const shared_event_ring& ring)
+    {
+        return ring.records_dropped;
+    }
+
+    // Mirrors the events published to selected addresses of a program into a shared event ring.
+    //
+    // Events of trivially copyable types are copied straight into the ring, while other types
+    // are serialized with their event_serializer. Either way, their type must have an
+    // event_serializer to name it. Events that find the ring full are dropped and counted.
+    //
+    // The sender subscribes to the events it mirrors as a subscriber of its own, which the program
+    // holds only weakly, so its subscriptions are never called once it is destroyed.
+    template<typename P>
+    class event_bus_sender
+    {
+    private:
+
+        shared_event_ring ring;
+        std::shared_ptr<addressable> participant;
+        std::shared_ptr<addressable> mirror;
+        std::vector<unsubscriber<P>> unsubscribers;
+        std::vector<unsigned char> buffer;
+        std::size_t dropped;
+
+    protected:
+
+        template<typename T, typename Q>
+        friend void mirror_events(Q& program, event_bus_sender<Q>& sender, const address& address);
+
+        template<typename T, typename Q>
+        friend bool send_event(event_bus_sender<Q>& sender, const T& event_data, const address& event_address);
+
+        template<typename Q>
+        friend std::size_t get_dropped_events(const event_bus_sender<Q>& sender);
+
+        template<typename Q>
+        friend void stop_mirroring_events(Q& program, event_bus_sender<Q>& sender);
+
+    public:
+
+        CONSTRAINT(event_bus_sender);
+
+        event_bus_sender(const event_bus_sender&) = delete;
+        event_bus_sender(event_bus_sender&&) = delete;
+        event_bus_sender& operator=(const event_bus_sender&) = delete;
+        event_bus_sender& operator=(event_bus_sender&&) = delete;
+
+        // Make a sender to the ring of the given name, which the receiving process must already
+        // have created. Events published by the given participant are not sent, which keeps events
+        // received by that participant from being echoed back.
+        event_bus_sender(const std::string& ring_name, const std::shared_ptr<addressable>& participant) :
+            ring(ring_name),
+            participant(participant),
+            mirror(std::make_shared<addressable>(name_t("event_bus_sender"))),
+            unsubscribers(),
+            buffer(),
+            dropped()
+        { }
+    };
+
+    // Send an event through a sender's ring, returning false if the ring was full.
+    template<typename T, typename P>
+    bool send_event(event_bus_sender<P>& sender, const T& event_data, const address& event_address)
+    {
+        static_assert(event_serializer<T>::value, "Event type must have an event_serializer.");
+        VAL tag = get_event_log_tag<T>();
+        if (std::is_trivially_copyable<T>::value)
+        {
+            VAL sent = try_write_shared_event(sender.ring, tag, event_address, sizeof(T), [&event_data](unsigned char* payload)
+            { std::memcpy(payload, &event_data, sizeof(T)); });
+            if (!sent) ++sender.dropped;
+            return sent;
+        }
+        sender.buffer.clear();
+        event_serializer<T>::write(event_data, sender.buffer);
+        VAL sent = try_write_shared_event(sender.ring, tag, event_address, sender.buffer.size(), [&sender](unsigned char* payload)
+        { std::memcpy(payload, sender.buffer.data(), sender.buffer.size()); });
+        if (!sent) ++sender.dropped;
+        return sent;
+    }
+
+    // Mirror the events of type T published to an address or address pattern of a program, such
+    // as 'world/**', through a sender.
+    template<typename T, typename P>
+    void mirror_events(P& program, event_bus_sender<P>& sender, const address& address)
+    {
+        CONSTRAIN(P, eventable);
+        VAR* sender_ptr = &sender;
+        sender.unsubscribers.push_back(subscribe_event<T, P>(program, address, sender.mirror, [sender_ptr](const event_view<T>& event, P&)
+        {
+            if (event.publisher != sender_ptr->participant) send_event(*sender_ptr, event.data, event.address);
+            return true;
+        }));
+    }
+
+    // Stop mirroring all of the events a sender mirrors. Destroying the sender also stops its
+    // mirroring, though its subscriptions are then only reclaimed when the program compacts them.
+    template<typename P>
+    void stop_mirroring_events(P& program, event_bus_sender<P>& sender)
+    {
+        CONSTRAIN(P, eventable);
+        for (VAL& unsubscriber : sender.unsubscribers) unsubscriber(program);
+        sender.unsubscribers.clear();
+    }
+
+    // Get how many events a sender has dropped because its ring was full.
+    template<typename P>
+    std::size_t get_dropped_events(const event_bus_sender<P>& sender)
+    {
+        return sender.dropped;
+    }
+
+    template<typename P>
+    using event_bus_publisher = void(*)(P& program, const unsigned char* payload, std::size_t payload_size, const address& event_address, const std::shared_ptr<addressable>& publisher);
+
+    // Receives the events sent through a shared event ring, re-publishing them into a program when
+    // pumped. Only the event types registered with receive_events are re-published.
+    template<typename P>
+    class event_bus_receiver
+    {
+    private:
+
+        shared_event_ring ring;
+        std::shared_ptr<addressable> participant;
+        std::unordered_map<std::uint64_t, event_bus_publisher<P>> publishers;
+        std::unordered_map<std::string, address> addresses;
+
+    protected:
+
+        template<typename T, typename Q>
+        friend void receive_events(event_bus_receiver<Q>& receiver);
+
+        template<typename Q>
+        friend std::size_t pump_events(Q& program, event_bus_receiver<Q>& receiver);
+
+        template<typename Q>
+        friend std::size_t get_dropped_events(const event_bus_receiver<Q>& receiver);
+
+    public:
+
+        CONSTRAINT(event_bus_receiver);
+
+        event_bus_receiver(const event_bus_receiver&) = delete;
+        event_bus_receiver(event_bus_receiver&&) = delete;
+        event_bus_receiver& operator=(const event_bus_receiver&) = delete;
+        event_bus_receiver& operator=(event_bus_receiver&&) = delete;
+
+        // Make a receiver that creates a ring of the given name and capacity, publishing the
+        // events it receives as the given participant.
+        event_bus_receiver(const std::string& ring_name, std::size_t capacity, const std::shared_ptr<addressable>& participant) :
+            ring(ring_name, capacity),
+            participant(participant),
+            publishers(),
+            addresses()
+        { }
+    };
+
+    // Publish an event received through a ring. A trivially copyable event is published directly
+    // from the ring's memory when suitably aligned, rather than being copied out.
+    template<typename T, typename P>
+    void publish_received_event(P& program, const unsigned char* payload, std::size_t payload_size, const address& event_address, const std::shared_ptr<addressable>& publisher)
+    {
+        if (std::is_trivially_copyable<T>::value && alignof(T) <= 16)
+        {
+            if (payload_size != sizeof(T)) throw std::runtime_error("Shared event payload has the wrong size for its type.");
+            publish_event(program, *reinterpret_cast<const T*>(payload), event_address, publisher);
+        }
+        else publish_event(program, event_serializer<T>::read(payload, payload_size), event_address, publisher);
+    }
+
+    // Register an event type for a receiver to re-publish.
+    template<typename T, typename P>
+    void receive_events(event_bus_receiver<P>& receiver)
+    {
+        static_assert(event_serializer<T>::value, "Event type must have an event_serializer.");
+        receiver.publishers[get_event_log_tag<T>()] = &publish_received_event<T, P>;
+    }
+
+    // Re-publish every event received so far into a program, returning how many were received.
+    // This is normally called once per frame.
+    template<typename P>
+    std::size_t pump_events(P& program, event_bus_receiver<P>& receiver)
+    {
+        CONSTRAIN(P, eventable);
+        return read_shared_events(receiver.ring, [&](std::uint64_t tag, const char* address_chars, std::size_t address_size, const unsigned char* payload, std::size_t payload_size)
+        {
+            VAL publisher_opt = receiver.publishers.find(tag);
+            if (publisher_opt == std::end(receiver.publishers)) return;
+            VAL address_str = std::string(address_chars, address_size);
+            VAR address_opt = receiver.addresses.find(address_str);
+            if (address_opt == std::end(receiver.addresses)) address_opt = receiver.addresses.emplace(address_str, address(address_str)).first;
+            publisher_opt->second(program, payload, payload_size, address_opt->second, receiver.participant);
+        });
+    }
+
+    // Get how many malformed records a receiver has dropped from its ring.
+    template<typename P>
+    std::size_t get_dropped_events(const event_bus_receiver<P>& receiver)
+    {
+        return get_dropped_records(receiver.ring);
+    }
+}
+
+#endif
+
+#endif
@@ -0,0 +1,205 @@
+#ifndef DAS_EVENT_LOG_HPP
+#define DAS_EVENT_LOG_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+
+#include "prelude.hpp"
+#include "hash.hpp"
+#include "name.hpp"
+#include "address.hpp"
+
+namespace das
+{
+    // Opts an event type into being recorded to and replayed from an event log. Specializations
+    // derive std::true_type and provide,
+    //
+    //  static const char* get_name(); // a name for the type that is stable across processes
+    //  static void write(const T& event_data, std::vector<unsigned char>& bytes); // appends
+    //  static T read(const unsigned char* bytes, std::size_t size);
+    //
+    // Events of types that are not opted in are simply not recorded.
+    template<typename T>
+    struct event_serializer : public std::false_type { };
+
+    // A serializer for trivially copyable event types, which copies their bytes as they are.
+    // Specializations of event_serializer may derive from it, adding just get_name.
+    template<typename T>
+    struct trivial_event_serializer : public std::true_type
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "Event type must be trivially copyable.");
+
+        static void write(const T& event_data, std::vector<unsigned char>& bytes)
+        {
+            VAL* begin = reinterpret_cast<const unsigned char*>(&event_data);
+            bytes.insert(std::end(bytes), begin, begin + sizeof(T));
+        }
+
+        static T read(const unsigned char* bytes, std::size_t size)
+        {
+            if (size != sizeof(T)) throw std::runtime_error("Event log payload has the wrong size for its type.");
+            T event_data;
+            std::memcpy(&event_data, bytes, sizeof(T));
+            return event_data;
+        }
+    };
+
+    template<>
+    struct event_serializer<std::string> : public std::true_type
+    {
+        static const char* get_name() { return "std::string"; }
+
+        static void write(const std::string& event_data, std::vector<unsigned char>& bytes)
+        {
+            bytes.insert(std::end(bytes), std::begin(event_data), std::end(event_data));
+        }
+
+        static std::string read(const unsigned char* bytes, std::size_t size)
+        {
+            return std::string(reinterpret_cast<const char*>(bytes), size);
+        }
+    };
+
+    // Get the tag that identifies a serializable event type in an event log, being the 64-bit
+    // FNV-1a hash of the type's serialized name.
+    inline std::uint64_t get_event_log_tag(const char* name)
+    {
+        return get_hash_fnv1a(name, std::strlen(name));
+    }
+
+    template<typename T>
+    std::uint64_t get_event_log_tag()
+    {
+        static const std::uint64_t tag = get_event_log_tag(event_serializer<T>::get_name());
+        return tag;
+    }
+
+    // The event log format. A log is the magic bytes followed by a sequence of records, each of
+    // which is its header, followed by its address as a 32-bit size and the characters of each of
+    // its names, followed by its payload. Names are written one by one rather than joined by '/'
+    // so that they may hold any character. Integers are written in the byte order of the recording
+    // machine.
+    constexpr char event_log_magic[8] = { 'D', 'A', 'S', 'L', 'O', 'G', '0', '2' };
+
+    struct event_log_record_header
+    {
+        std::uint64_t sequence;
+        std::uint64_t tag;
+        std::uint32_t address_size;
+        std::uint32_t payload_size;
+    };
+
+    // Records the events published by a program to an append-only binary log. Records are
+    // buffered, and written out as the buffer fills, on flush, and on destruction.
+    class event_recorder
+    {
+    private:
+
+        std::ofstream stream;
+        std::vector<unsigned char> buffer;
+        std::uint64_t sequence;
+
+    protected:
+
+        template<typename T>
+        friend void record_event(event_recorder& recorder, const T& event_data, const address& event_address);
+
+        friend void flush_event_recorder(event_recorder& recorder);
+
+    public:
+
+        CONSTRAINT(event_recorder);
+
+        event_recorder(const event_recorder&) = delete;
+        event_recorder(event_recorder&&) = delete;
+        event_recorder& operator=(const event_recorder&) = delete;
+        event_recorder& operator=(event_recorder&&) = delete;
+
+        explicit event_recorder(const std::string& file_path) :
+            stream(file_path, std::ios::binary | std::ios::trunc),
+            buffer(),
+            sequence()
+        {
+            if (!stream) throw std::runtime_error("Could not open event log '" + file_path + "'.");
+            stream.write(event_log_magic, sizeof(event_log_magic));
+        }
+
+        ~event_recorder()
+        {
+            stream.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+        }
+    };
+
+    // Write out a recorder's buffered records.
+    inline void flush_event_recorder(event_recorder& recorder)
+    {
+        recorder.stream.write(reinterpret_cast<const char*>(recorder.buffer.data()), static_cast<std::streamsize>(recorder.buffer.size()));
+        recorder.stream.flush();
+        recorder.buffer.clear();
+        if (!recorder.stream) throw std::runtime_error("Could not write event log.");
+    }
+
+    // Append an event to a recorder's log.
+    template<typename T>
+    void record_event(event_recorder& recorder, const T& event_data, const address& event_address)
+    {
+        // reserve the header, filling it in once the sizes are known
+        VAR& buffer = recorder.buffer;
+        VAL header_offset = buffer.size();
+        buffer.resize(header_offset + sizeof(event_log_record_header));
+        VAL address_offset = buffer.size();
+        for (VAL& name : get_names(event_address))
+        {
+            VAL& name_str = get_name_str(name);
+            VAL name_size = static_cast<std::uint32_t>(name_str.size());
+            VAL* name_size_bytes = reinterpret_cast<const unsigned char*>(&name_size);
+            buffer.insert(std::end(buffer), name_size_bytes, name_size_bytes + sizeof(name_size));
+            buffer.insert(std::end(buffer), std::begin(name_str), std::end(name_str));
+        }
+        VAL payload_offset = buffer.size();
+        event_serializer<T>::write(event_data, buffer);
+        VAL header = event_log_record_header
+        {
+            recorder.sequence++,
+            get_event_log_tag<T>(),
+            static_cast<std::uint32_t>(payload_offset - address_offset),
+            static_cast<std::uint32_t>(buffer.size() - payload_offset)
+        };
+        std::memcpy(buffer.data() + header_offset, &header, sizeof(header));
+        if (buffer.size() >= 64 * 1024) flush_event_recorder(recorder);
+    }
+
+    // Read an address recorded in an event log, throwing if its names overrun it.
+    inline address read_event_log_address(const unsigned char* bytes, std::size_t size)
+    {
+        address_names names{};
+        for (std::size_t offset = 0; offset != size;)
+        {
+            std::uint32_t name_size;
+            if (size - offset < sizeof(name_size)) throw std::runtime_error("Event log address is malformed.");
+            std::memcpy(&name_size, bytes + offset, sizeof(name_size));
+            offset += sizeof(name_size);
+            if (size - offset < name_size) throw std::runtime_error("Event log address is malformed.");
+            names.push_back(name_t(std::string(reinterpret_cast<const char*>(bytes + offset), name_size)));
+            offset += name_size;
+        }
+        return address(std::move(names));
+    }
+
+    template<typename T>
+    void record_event(event_recorder&, const T&, const address&, std::false_type) { }
+
+    template<typename T>
+    void record_event(event_recorder& recorder, const T& event_data, const address& event_address, std::true_type)
+    {
+        record_event(recorder, event_data, event_address);
+    }
+}
+
+#endif
@@ -0,0 +1,241 @@
+#ifndef DAS_EVENT_PLAYER_HPP
+#define DAS_EVENT_PLAYER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <memory>
+#include <vector>
+#include <stdexcept>
+#include <unordered_map>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "prelude.hpp"
+#include "addressable.hpp"
+#include "address.hpp"
+#include "eventable.hpp"
+#include "event_log.hpp"
+
+namespace das
+{
+    // A read-only memory mapping of a whole file.
+    class mapped_file
+    {
+    private:
+
+        const unsigned char* data;
+        std::size_t size;
+#ifdef _WIN32
+        HANDLE file;
+        HANDLE mapping;
+#endif
+
+    protected:
+
+        friend const unsigned char* get_mapped_data(const mapped_file& file);
+        friend std::size_t get_mapped_size(const mapped_file& file);
+
+    public:
+
+        CONSTRAINT(mapped_file);
+
+        mapped_file(const mapped_file&) = delete;
+        mapped_file(mapped_file&&) = delete;
+        mapped_file& operator=(const mapped_file&) = delete;
+        mapped_file& operator=(mapped_file&&) = delete;
+
+#ifdef _WIN32
+        explicit mapped_file(const std::string& file_path) : data(), size(), file(INVALID_HANDLE_VALUE), mapping()
+        {
+            file = CreateFileA(file_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file == INVALID_HANDLE_VALUE) throw std::runtime_error("Could not open '" + file_path + "'.");
+            LARGE_INTEGER file_size;
+            if (!GetFileSizeEx(file, &file_size)) { CloseHandle(file); throw std::runtime_error("Could not size '" + file_path + "'."); }
+            size = static_cast<std::size_t>(file_size.QuadPart);
+            if (size == 0) return;
+            mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping) data = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+            if (!data)
+            {
+                if (mapping) CloseHandle(mapping);
+                CloseHandle(file);
+                throw std::runtime_error("Could not map '" + file_path + "'.");
+            }
+        }
+
+        ~mapped_file()
+        {
+            if (data) UnmapViewOfFile(data);
+            if (mapping) CloseHandle(mapping);
+            CloseHandle(file);
+        }
+#else
+        explicit mapped_file(const std::string& file_path) : data(), size()
+        {
+            VAL file = open(file_path.c_str(), O_RDONLY);
+            if (file < 0) throw std::runtime_error("Could not open '" + file_path + "'.");
+            struct stat file_stat;
+            if (fstat(file, &file_stat) != 0) { close(file); throw std::runtime_error("Could not size '" + file_path + "'."); }
+            size = static_cast<std::size_t>(file_stat.st_size);
+            if (size != 0)
+            {
+                VAR* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+                if (mapping == MAP_FAILED) { close(file); throw std::runtime_error("Could not map '" + file_path + "'."); }
+                data = static_cast<const unsigned char*>(mapping);
+            }
+            close(file);
+        }
+
+        ~mapped_file()
+        {
+            if (data) munmap(const_cast<unsigned char*>(data), size);
+        }
+#endif
+    };
+
+    inline const unsigned char* get_mapped_data(const mapped_file& file)
+    {
+        return file.data;
+    }
+
+    inline std::size_t get_mapped_size(const mapped_file& file)
+    {
+        return file.size;
+    }
+
+    template<typename P>
+    using event_replayer = void(*)(P& program, const unsigned char* payload, std::size_t payload_size, const address& event_address, const std::shared_ptr<addressable>& publisher);
+
+    // A record of an event log, as indexed by an event player.
+    struct event_log_entry
+    {
+        std::uint64_t tag;
+        std::size_t address_index;
+        const unsigned char* payload;
+        std::size_t payload_size;
+    };
+
+    // Plays back an event log recorded by an event_recorder, re-publishing its events into a
+    // program as fast as the program can take them.
+    //
+    // The log is memory mapped and indexed when the player is made, with each distinct address
+    // parsed just once, so playback itself only deserializes payloads and publishes them. Only
+    // the events of types registered with register_event_replay are played back.
+    template<typename P>
+    class event_player
+    {
+    private:
+
+        mapped_file file;
+        std::vector<address> addresses;
+        std::vector<event_log_entry> entries;
+        std::unordered_map<std::uint64_t, event_replayer<P>> replayers;
+
+    protected:
+
+        template<typename T, typename Q>
+        friend void register_event_replay(event_player<Q>& player);
+
+        template<typename Q>
+        friend std::size_t get_event_log_size(const event_player<Q>& player);
+
+        template<typename Q>
+        friend std::size_t replay_events(Q& program, const event_player<Q>& player, const std::shared_ptr<addressable>& publisher);
+
+    public:
+
+        CONSTRAINT(event_player);
+
+        event_player(const event_player&) = delete;
+        event_player(event_player&&) = delete;
+        event_player& operator=(const event_player&) = delete;
+        event_player& operator=(event_player&&) = delete;
+
+        explicit event_player(const std::string& file_path) : file(file_path), addresses(), entries(), replayers()
+        {
+            VAL* data = get_mapped_data(file);
+            VAL size = get_mapped_size(file);
+            if (size < sizeof(event_log_magic) || std::memcmp(data, event_log_magic, sizeof(event_log_magic)) != 0)
+                throw std::runtime_error("'" + file_path + "' is not an event log.");
+            std::unordered_map<std::string, std::size_t> address_indices{};
+            for (VAR offset = sizeof(event_log_magic); offset != size;)
+            {
+                event_log_record_header header;
+                if (size - offset < sizeof(header)) throw std::runtime_error("Event log '" + file_path + "' is truncated.");
+                std::memcpy(&header, data + offset, sizeof(header));
+                offset += sizeof(header);
+                if (size - offset < std::size_t(header.address_size) + header.payload_size) throw std::runtime_error("Event log '" + file_path + "' is truncated.");
+                VAL address_bytes = std::string(reinterpret_cast<const char*>(data + offset), header.address_size);
+                VAL address_index = address_indices.emplace(address_bytes, addresses.size());
+                if (address_index.second) addresses.push_back(read_event_log_address(data + offset, header.address_size));
+                offset += header.address_size;
+                entries.push_back(event_log_entry{ header.tag, address_index.first->second, data + offset, header.payload_size });
+                offset += header.payload_size;
+            }
+        }
+    };
+
+    template<typename T, typename P>
+    void replay_event(P& program, const unsigned char* payload, std::size_t payload_size, const address& event_address, const std::shared_ptr<addressable>& publisher)
+    {
+        publish_event(program, event_serializer<T>::read(payload, payload_size), event_address, publisher);
+    }
+
+    // Register an event type to be played back by a player.
+    template<typename T, typename P>
+    void register_event_replay(event_player<P>& player)
+    {
+        static_assert(event_serializer<T>::value, "Event type must have an event_serializer.");
+        player.replayers[get_event_log_tag<T>()] = &replay_event<T, P>;
+    }
+
+    // Get how many events a player's log holds.
+    template<typename P>
+    std::size_t get_event_log_size(const event_player<P>& player)
+    {
+        return player.entries.size();
+    }
+
+    // Publish the events of a player's log into a program in the order they were recorded, as if
+    // by the given publisher, returning how many were of registered types and thus published.
+    template<typename P>
+    std::size_t replay_events(P& program, const event_player<P>& player, const std::shared_ptr<addressable>& publisher)
+    {
+        CONSTRAIN(P, eventable);
+        std::size_t replayed = 0;
+        std::uint64_t tag = 0;
+        event_replayer<P> replayer_opt = nullptr;
+        for (VAL& entry : player.entries)
+        {
+            if (entry.tag != tag || !replayer_opt)
+            {
+                VAL replayer_found = player.replayers.find(entry.tag);
+                tag = entry.tag;
+                replayer_opt = replayer_found != std::end(player.replayers) ? replayer_found->second : nullptr;
+            }
+            if (replayer_opt)
+            {
+                replayer_opt(program, entry.payload, entry.payload_size, player.addresses[entry.address_index], publisher);
+                ++replayed;
+            }
+        }
+        return replayed;
+    }
+}
+
+#endif
@@ -0,0 +1,237 @@
+#ifndef DAS_EVENT_QUEUE_HPP
+#define DAS_EVENT_QUEUE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <memory>
+#include <utility>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+
+#include "prelude.hpp"
+#include "hash.hpp"
+#include "addressable.hpp"
+#include "address.hpp"
+#include "subscription.hpp"
+
+namespace das
+{
+    // A bump allocator for the payloads of queued events. Its memory is kept when it is reset, so
+    // once it has grown to fit a frame's worth of events, it no longer touches the allocator.
+    class event_arena
+    {
+    private:
+
+        std::vector<std::pair<std::unique_ptr<unsigned char[]>, std::size_t>> chunks;
+        std::size_t chunk_index;
+        std::size_t chunk_offset;
+
+    protected:
+
+        friend void* allocate_event_data(event_arena& arena, std::size_t size, std::size_t alignment);
+        friend void reset_event_arena(event_arena& arena);
+
+    public:
+
+        CONSTRAINT(event_arena);
+
+        event_arena() : chunks(), chunk_index(), chunk_offset() { }
+        event_arena(const event_arena&) = delete;
+        event_arena(event_arena&&) = default;
+        event_arena& operator=(const event_arena&) = delete;
+        event_arena& operator=(event_arena&&) = default;
+    };
+
+    // Allocate uninitialized memory for an event payload from an arena.
+    inline void* allocate_event_data(event_arena& arena, std::size_t size, std::size_t alignment)
+    {
+        while (arena.chunk_index < arena.chunks.size())
+        {
+            VAL& chunk = arena.chunks[arena.chunk_index];
+            VAL chunk_begin = reinterpret_cast<std::uintptr_t>(chunk.first.get());
+            VAL data_begin = (chunk_begin + arena.chunk_offset + pred(alignment)) & ~static_cast<std::uintptr_t>(pred(alignment));
+            if (data_begin + size <= chunk_begin + chunk.second)
+            {
+                arena.chunk_offset = data_begin + size - chunk_begin;
+                return reinterpret_cast<void*>(data_begin);
+            }
+            ++arena.chunk_index;
+            arena.chunk_offset = 0z;
+        }
+        VAL chunk_size = std::max<std::size_t>(64z * 1024z, size + alignment);
+        arena.chunks.emplace_back(std::unique_ptr<unsigned char[]>(new unsigned char[chunk_size]), chunk_size);
+        return allocate_event_data(arena, size, alignment);
+    }
+
+    // Reset an arena for reuse, keeping its memory. Any payloads still in it must already have been
+    // destroyed.
+    inline void reset_event_arena(event_arena& arena)
+    {
+        arena.chunk_index = 0z;
+        arena.chunk_offset = 0z;
+    }
+
+    template<typename P>
+    struct queued_event;
+
+    template<typename P>
+    using queued_events_publisher = void(*)(P& program, const queued_event<P>* begin, const queued_event<P>* end);
+
+    // An event that has been queued for publishing. Its payload lives in the queue's arena, and is
+    // typed only by the functions that know how to destroy and publish it.
+    template<typename P>
+    struct queued_event
+    {
+        CONSTRAINT(queued_event);
+
+        void* data;
+        event_type_key event_type;
+        das::address address;
+        std::shared_ptr<addressable> publisher;
+        void(*destroy)(void* data);
+        queued_events_publisher<P> publish;
+    };
+
+    // A queue of events deferred until the queue is drained, which is normally once per frame.
+    //
+    // Draining publishes the queued events in batches grouped by address and event type, so the
+    // subscriptions of each batch need only be found once. Addresses may also be set to coalesce,
+    // in which case only the latest payload of each type queued to them is published per drain.
+    template<typename P>
+    class event_queue
+    {
+    private:
+
+        std::vector<queued_event<P>> events;
+        event_arena arena;
+        std::vector<queued_event<P>> events_draining;
+        event_arena arena_draining;
+        std::unordered_map<address, std::vector<std::pair<event_type_key, std::size_t>>> coalescings;
+        bool draining;
+
+    protected:
+
+        template<typename T, typename Q>
+        friend void enqueue_queued_event(event_queue<Q>& queue, const T& event_data, const address& event_address, const std::shared_ptr<addressable>& publisher, queued_events_publisher<Q> publish);
+
+        template<typename Q>
+        friend void set_queue_coalescing(event_queue<Q>& queue, const address& address, bool coalesce);
+
+        template<typename Q>
+        friend std::size_t drain_queued_events(event_queue<Q>& queue, Q& program);
+
+    public:
+
+        CONSTRAINT(event_queue);
+
+        event_queue() :
+            events(),
+            arena(),
+            events_draining(),
+            arena_draining(),
+            coalescings(),
+            draining(false)
+        { }
+
+        event_queue(const event_queue&) = delete;
+        event_queue(event_queue&&) = delete;
+        event_queue& operator=(const event_queue&) = delete;
+        event_queue& operator=(event_queue&&) = delete;
+
+        ~event_queue()
+        {
+            for (VAL& event : events) event.destroy(event.data);
+        }
+    };
+
+    template<typename T>
+    void destroy_queued_event_data(void* data)
+    {
+        static_cast<T*>(data)->~T();
+    }
+
+    // Enqueue an event to be published by the given function when the queue is drained.
+    template<typename T, typename P>
+    void enqueue_queued_event(event_queue<P>& queue, const T& event_data, const address& event_address, const std::shared_ptr<addressable>& publisher, queued_events_publisher<P> publish)
+    {
+        VAL event_type = get_event_type_key<T>();
+        VAR coalescing_opt = queue.coalescings.find(event_address);
+        if (coalescing_opt != std::end(queue.coalescings))
+        {
+            for (VAL& pending : coalescing_opt->second)
+            {
+                if (pending.first == event_type)
+                {
+                    VAR& event = queue.events[pending.second];
+                    *static_cast<T*>(event.data) = event_data;
+                    event.publisher = publisher;
+                    return;
+                }
+            }
+            coalescing_opt->second.emplace_back(event_type, queue.events.size());
+        }
+        VAR* data = allocate_event_data(queue.arena, sizeof(T), alignof(T));
+        new (data) T(event_data);
+        queue.events.push_back(queued_event<P>{ data, event_type, event_address, publisher, &destroy_queued_event_data<T>, publish });
+    }
+
+    // Set whether the events queued to an address coalesce such that only the latest payload of
+    // each event type is published per drain.
+    template<typename P>
+    void set_queue_coalescing(event_queue<P>& queue, const address& address, bool coalesce)
+    {
+        if (coalesce) queue.coalescings[address];
+        else queue.coalescings.erase(address);
+    }
+
+    // Publish and then discard every event queued before the drain began, returning how many were
+    // published. Events queued while draining are left for the next drain, and draining from
+    // within a drain does nothing.
+    template<typename P>
+    std::size_t drain_queued_events(event_queue<P>& queue, P& program)
+    {
+        if (queue.draining) return 0z;
+        queue.draining = true;
+        std::swap(queue.events, queue.events_draining);
+        std::swap(queue.arena, queue.arena_draining);
+        for (VAR& coalescing : queue.coalescings) coalescing.second.clear();
+
+        // group by address and event type, keeping events within a group in the order they were
+        // queued
+        VAR& events = queue.events_draining;
+        std::stable_sort(std::begin(events), std::end(events), [](VAL& left, VAL& right)
+        {
+            VAL left_hash = get_hash(left.address);
+            VAL right_hash = get_hash(right.address);
+            if (left_hash != right_hash) return left_hash < right_hash;
+            return std::less<event_type_key>()(left.event_type, right.event_type);
+        });
+
+        // discard the drained events even if a handler throws
+        VAL discard_events = [&queue, &events]()
+        {
+            for (VAL& event : events) event.destroy(event.data);
+            events.clear();
+            reset_event_arena(queue.arena_draining);
+            queue.draining = false;
+        };
+
+        VAL drained = events.size();
+        VAL* events_end = events.data() + events.size();
+        for (VAL* group_begin = events.data(); group_begin != events_end;)
+        {
+            VAL* group_end = std::find_if(group_begin, events_end, [group_begin](VAL& event)
+            { return event.event_type != group_begin->event_type || !(event.address == group_begin->address); });
+            try { group_begin->publish(program, group_begin, group_end); }
+            catch (...) { discard_events(); throw; }
+            group_begin = group_end;
+        }
+        discard_events();
+        return drained;
+    }
+}
+
+#endif
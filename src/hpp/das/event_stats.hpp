@@ -0,0 +1,254 @@
+#ifndef DAS_EVENT_STATS_HPP
+#define DAS_EVENT_STATS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <array>
+#include <chrono>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <unordered_map>
+#include <ostream>
+
+#include "prelude.hpp"
+#include "id.hpp"
+#include "name.hpp"
+#include "address.hpp"
+
+namespace das
+{
+    // A histogram of latencies in nanoseconds, bucketed in the manner of an HDR histogram. Each
+    // power of two is split into 16 linear sub-buckets, so any recorded latency is known to within
+    // about 6%, and a histogram takes the same fixed space however many latencies it records.
+    // Latencies of 2^41 nanoseconds, about 36.6 minutes, or more are recorded as the largest
+    // trackable latency.
+    class latency_histogram
+    {
+    private:
+
+        std::array<std::uint64_t, 608> counts;
+        std::uint64_t count;
+        std::uint64_t max;
+
+    protected:
+
+        friend std::size_t get_latency_bucket(std::uint64_t latency);
+        friend std::uint64_t get_latency_bucket_floor(std::size_t bucket);
+        friend void record_latency(latency_histogram& histogram, std::uint64_t latency);
+        friend std::uint64_t get_latency_count(const latency_histogram& histogram);
+        friend std::uint64_t get_latency_max(const latency_histogram& histogram);
+        friend std::uint64_t get_latency_percentile(const latency_histogram& histogram, double percentile);
+
+    public:
+
+        CONSTRAINT(latency_histogram);
+
+        latency_histogram() : counts(), count(), max() { }
+        latency_histogram(const latency_histogram&) = default;
+        latency_histogram(latency_histogram&&) = default;
+        latency_histogram& operator=(const latency_histogram&) = default;
+        latency_histogram& operator=(latency_histogram&&) = default;
+    };
+
+    // Get the bucket of a histogram that a latency is recorded in.
+    inline std::size_t get_latency_bucket(std::uint64_t latency)
+    {
+        latency = std::min<std::uint64_t>(latency, (std::uint64_t(1) << 41) - 1);
+        if (latency < 32) return static_cast<std::size_t>(latency);
+        std::size_t msb = 5;
+        while ((latency >> msb) > 1) ++msb;
+        VAL shift = msb - 4;
+        return (shift + 1) * 16 + static_cast<std::size_t>((latency >> shift) - 16);
+    }
+
+    // Get the least latency recorded in a bucket of a histogram.
+    inline std::uint64_t get_latency_bucket_floor(std::size_t bucket)
+    {
+        if (bucket < 32) return bucket;
+        VAL shift = bucket / 16 - 1;
+        return static_cast<std::uint64_t>(bucket % 16 + 16) << shift;
+    }
+
+    inline void record_latency(latency_histogram& histogram, std::uint64_t latency)
+    {
+        ++histogram.counts[get_latency_bucket(latency)];
+        ++histogram.count;
+        histogram.max = std::max(histogram.max, latency);
+    }
+
+    inline std::uint64_t get_latency_count(const latency_histogram& histogram)
+    {
+        return histogram.count;
+    }
+
+    inline std::uint64_t get_latency_max(const latency_histogram& histogram)
+    {
+        return histogram.max;
+    }
+
+    // Get the latency below which the given percentile of the recorded latencies fall, to within
+    // the precision of the histogram.
+    inline std::uint64_t get_latency_percentile(const latency_histogram& histogram, double percentile)
+    {
+        if (histogram.count == 0) return 0;
+        VAL rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(percentile / 100.0 * static_cast<double>(histogram.count) + 0.5));
+        std::uint64_t seen = 0;
+        for (std::size_t bucket = 0; bucket < histogram.counts.size(); ++bucket)
+        {
+            seen += histogram.counts[bucket];
+            if (seen >= rank) return std::min(get_latency_bucket_floor(bucket), histogram.max);
+        }
+        return histogram.max;
+    }
+
+    // The dispatch statistics of an address.
+    struct address_stats
+    {
+        CONSTRAINT(address_stats);
+
+        std::uint64_t publishes;
+        std::uint64_t deliveries;
+        std::uint64_t cascade_aborts;
+    };
+
+    // The dispatch statistics of a subscription, kept from when it is made until it is
+    // unsubscribed or reclaimed.
+    struct subscription_stats
+    {
+        CONSTRAINT(subscription_stats);
+
+        das::address address;
+        latency_histogram latency;
+    };
+
+    // The dispatch statistics of an eventable program, gathered only when DAS_EVENT_STATS is
+    // defined.
+    //
+    // The statistics of at most address_capacity addresses are kept, so that a long-running program
+    // publishing to ever new addresses does not grow without bound. When a new address finds the
+    // table full, the half of its addresses published to least often are evicted first.
+    class event_stats
+    {
+    private:
+
+        static constexpr std::size_t address_capacity = 4096;
+
+        std::unordered_map<address, address_stats> addresses;
+        std::unordered_map<id_t, subscription_stats> subscriptions;
+
+    protected:
+
+        friend address_stats& get_address_stats(event_stats& stats, const address& address);
+        friend void record_event_publish(event_stats& stats, const address& address);
+        friend void add_subscription_stats(event_stats& stats, id_t subscription_id, const address& address);
+        friend void remove_subscription_stats(event_stats& stats, id_t subscription_id);
+        friend void record_event_delivery(event_stats& stats, id_t subscription_id, const address& address, std::chrono::steady_clock::duration latency, bool cascade);
+        friend void write_event_stats(std::ostream& stream, const event_stats& stats, std::size_t top_count);
+
+    public:
+
+        CONSTRAINT(event_stats);
+
+        event_stats() : addresses(), subscriptions() { }
+        event_stats(const event_stats&) = delete;
+        event_stats(event_stats&&) = delete;
+        event_stats& operator=(const event_stats&) = delete;
+        event_stats& operator=(event_stats&&) = delete;
+    };
+
+    // Get the statistics of an address, adding them if there are none, and making room for them
+    // when the table is full.
+    inline address_stats& get_address_stats(event_stats& stats, const address& address)
+    {
+        VAL address_stats_opt = stats.addresses.find(address);
+        if (address_stats_opt != std::end(stats.addresses)) return address_stats_opt->second;
+        if (stats.addresses.size() >= event_stats::address_capacity)
+        {
+            std::vector<std::unordered_map<das::address, address_stats>::const_iterator> evicted{};
+            evicted.reserve(stats.addresses.size());
+            for (VAR it = stats.addresses.cbegin(); it != stats.addresses.cend(); ++it) evicted.push_back(it);
+            VAL evicted_end = std::begin(evicted) + static_cast<std::ptrdiff_t>(evicted.size() / 2);
+            std::nth_element(std::begin(evicted), evicted_end, std::end(evicted), [](VAL& left, VAL& right) { return left->second.publishes < right->second.publishes; });
+            for (VAR it = std::begin(evicted); it != evicted_end; ++it) stats.addresses.erase(*it);
+        }
+        return stats.addresses.emplace(address, address_stats{ 0, 0, 0 }).first->second;
+    }
+
+    inline void record_event_publish(event_stats& stats, const address& address)
+    {
+        ++get_address_stats(stats, address).publishes;
+    }
+
+    // Start the statistics of a subscription made to the given address or address pattern.
+    inline void add_subscription_stats(event_stats& stats, id_t subscription_id, const address& address)
+    {
+        stats.subscriptions.erase(subscription_id);
+        stats.subscriptions.emplace(subscription_id, subscription_stats{ address, latency_histogram() });
+    }
+
+    // Drop the statistics of a subscription that is unsubscribed or reclaimed.
+    inline void remove_subscription_stats(event_stats& stats, id_t subscription_id)
+    {
+        stats.subscriptions.erase(subscription_id);
+    }
+
+    // Record a call of a subscription's handler for an event published to an address.
+    inline void record_event_delivery(event_stats& stats, id_t subscription_id, const address& address, std::chrono::steady_clock::duration latency, bool cascade)
+    {
+        VAR& address_stats = get_address_stats(stats, address);
+        ++address_stats.deliveries;
+        if (!cascade) ++address_stats.cascade_aborts;
+        VAL subscription_stats_opt = stats.subscriptions.find(subscription_id);
+        if (subscription_stats_opt == std::end(stats.subscriptions)) return;
+        record_latency(subscription_stats_opt->second.latency, static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count()));
+    }
+
+    inline void write_event_stats_address(std::ostream& stream, const address& address)
+    {
+        VAR first = true;
+        for (VAL& name : get_names(address))
+        {
+            if (!first) stream << '/';
+            stream << get_name_str(name);
+            first = false;
+        }
+    }
+
+    // Write the addresses published to most often and the subscriptions with the slowest handlers,
+    // up to the given count of each.
+    inline void write_event_stats(std::ostream& stream, const event_stats& stats, std::size_t top_count)
+    {
+        std::vector<const std::pair<const address, address_stats>*> addresses{};
+        for (VAL& address : stats.addresses) addresses.push_back(&address);
+        std::sort(std::begin(addresses), std::end(addresses), [](VAL* left, VAL* right) { return left->second.publishes > right->second.publishes; });
+        addresses.resize(std::min(addresses.size(), top_count));
+        stream << "address,publishes,deliveries,mean_fan_out,cascade_aborts\n";
+        for (VAL* address : addresses)
+        {
+            VAL& address_stats = address->second;
+            write_event_stats_address(stream, address->first);
+            stream << ',' << address_stats.publishes << ',' << address_stats.deliveries << ',';
+            stream << (address_stats.publishes ? static_cast<double>(address_stats.deliveries) / static_cast<double>(address_stats.publishes) : 0.0);
+            stream << ',' << address_stats.cascade_aborts << '\n';
+        }
+
+        std::vector<std::pair<std::uint64_t, const std::pair<const id_t, subscription_stats>*>> subscriptions{};
+        for (VAL& subscription : stats.subscriptions) subscriptions.emplace_back(get_latency_percentile(subscription.second.latency, 99.0), &subscription);
+        std::sort(std::begin(subscriptions), std::end(subscriptions), [](VAL& left, VAL& right) { return left.first > right.first; });
+        subscriptions.resize(std::min(subscriptions.size(), top_count));
+        stream << "subscription,address,calls,p50_ns,p99_ns,max_ns\n";
+        for (VAL& subscription : subscriptions)
+        {
+            VAL& latency = subscription.second->second.latency;
+            stream << subscription.second->first.x << ':' << subscription.second->first.y << ',';
+            write_event_stats_address(stream, subscription.second->second.address);
+            stream << ',' << get_latency_count(latency);
+            stream << ',' << get_latency_percentile(latency, 50.0);
+            stream << ',' << subscription.first;
+            stream << ',' << get_latency_max(latency) << '\n';
+        }
+    }
+}
+
+#endif
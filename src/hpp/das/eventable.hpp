@@ -2,7 +2,11 @@
 #define DAS_EVENT_SYSTEM_HPP
 
 #include <cstddef>
+#include <stdexcept>
 #include <functional>
+#include <algorithm>
+#include <type_traits>
+#include <vector>
 #include <unordered_map>
 #include <memory>
 
@@ -11,7 +15,16 @@
 #include "castable.hpp"
 #include "addressable.hpp"
 #include "address.hpp"
+#include "address_trie.hpp"
 #include "subscription.hpp"
+#include "event_queue.hpp"
+#include "thread_pool.hpp"
+#include "event_log.hpp"
+#include "property_store.hpp"
+#ifdef DAS_EVENT_STATS
+#include <ostream>
+#include "event_stats.hpp"
+#endif
 
 namespace das
 {
@@ -21,30 +34,167 @@ namespace das
     // A program mixin for enabling publisher-neutral events in a program. What is a program mixin?
     // Well, it's like any other C++ mixin, except it's intended for use on the type that end-user
     // will represent his program with. Program mixins are the good alternative to OOP Singletons.
+    //
+    // Subscriptions may be made to exact addresses or to address patterns. A pattern segment of '*'
+    // matches any single segment, and a trailing segment of '**' matches one or more segments, so
+    // 'world/zone7/**' matches every address under 'world/zone7'. Exact addresses are looked up by
+    // hash while patterns are kept in a trie, so publishing to an address costs one hash lookup
+    // plus one walk of the address' segments regardless of how many patterns are subscribed.
+    //
+    // Each address or pattern is further divided into channels by event type, so a subscription
+    // only ever sees the events of the type it was made for. Delivering an event is therefore a
+    // direct call to the handler with no type checks, and a handler that does not accept the
+    // subscription's event type is rejected at compile time.
+    //
+    // Publishing is reentrant; handlers may freely publish, subscribe, and unsubscribe. Instead of
+    // copying a channel's subscriptions to guard against their modification, a publish borrows the
+    // channel's snapshot, which is never mutated during a publish, and any snapshot replaced during
+    // a publish is retired until the outermost publish completes.
+    //
+    // Within each channel, subscriptions are published to in order of descending priority, and
+    // those of equal priority in the order they were made. As channels are kept in that order as
+    // subscriptions are made, publishing never sorts anything. A high priority subscription may
+    // thus filter the events of a channel by cancelling their propagation before the rest see them.
+    // Channels of exact addresses are published to before those of patterns.
+    //
+    // Subscription ids are handles into a slot map of the program's subscriptions, so
+    // unsubscribing finds its subscription in constant time. Ids supplied by the caller rather than
+    // reserved with get_subscription_id are also accepted, and are kept in a hash map instead.
+    // Subscribing outside of any publish inserts into its channel's snapshot in place, while
+    // subscribing during a publish copies the snapshot so as not to disturb the publish. An
+    // unsubscribed subscription is marked rather than removed from its channel right away, and a
+    // channel's marked subscriptions are compacted away together once they make up more than half
+    // of it.
+    //
+    // Subscriptions whose subscribers have died are skipped by publishing, and are reclaimed by
+    // compact_subscriptions, either all at once or a bounded number of channels per call, such as
+    // once per frame. Compacting outside of any publish also removes the channels left empty, and
+    // the addresses left without channels, so addresses that come and go do not accumulate.
+    //
+    // Events may also be deferred with enqueue_event rather than published immediately, to be
+    // published in batches when the program calls drain_events, usually once per frame. This keeps
+    // cascades of events from recursing, and lets high-frequency events coalesce per frame.
+    //
+    // Finally, an event with many independent subscribers may be published with
+    // publish_event_parallel, which fans its handlers out across a thread pool.
+    //
+    // Besides subscriptions, each channel keeps an intrusive list of one-shot waiters, which are
+    // resumed after the channel's subscriptions by the next event published to it. This is what
+    // lets a coroutine co_await the next event at an address (see event_awaiter.hpp).
+    //
+    // Property stores may be observed by the program with observe_property_changes, such that
+    // flush_property_changes publishes one property_change event per property written since the
+    // last flush, usually once per frame, rather than one per write.
+    //
+    // A program may also be given an event_recorder, to which every event of a serializable type
+    // is appended as it is published, for replay with an event_player.
+    //
+    // When DAS_EVENT_STATS is defined, the program also gathers the publish counts, fan-out, and
+    // cascade aborts of each address along with a latency histogram of each subscription's
+    // handler, reported by dump_event_stats. Otherwise, none of this is compiled.
     template<typename P>
     class eventable : public castable
     {
     private:
 
-        std::unique_ptr<id_t> pred_id;
-        subscriptions_map subscriptions_map;
-        unsubscription_map unsubscription_map;
+        std::vector<subscription_slot> subscription_slots;
+        std::vector<std::size_t> subscription_slots_free;
+        std::unordered_map<id_t, subscription_slot> subscription_slots_external;
+        das::subscriptions_map subscriptions_map;
+        subscription_trie pattern_subscriptions;
+        std::vector<subscription_channel*> channels;
+        std::size_t channels_compacted;
+        std::size_t subscriptions_reclaimed;
+        std::size_t publish_depth;
+        std::vector<subscription_snapshot> retired_snapshots;
+        event_queue<P> deferred_events;
+        event_recorder* event_recorder_opt;
+        das::property_changes property_changes;
+#ifdef DAS_EVENT_STATS
+        das::event_stats event_stats;
+#endif
 
     protected:
 
         ENABLE_CAST(eventable<P>, castable);
 
-        template<typename P>
-        friend id_t get_subscription_id(P& program);
+        template<typename Q>
+        friend id_t get_subscription_id(Q& program);
+
+        template<typename Q>
+        friend subscription_slot* try_get_subscription_slot(Q& program, id_t subscription_id);
+
+        template<typename Q>
+        friend subscription_channel& get_or_add_channel(Q& program, const channel_key& channel_key);
+
+        template<typename Q>
+        friend subscription_list& get_subscriptions_writable(Q& program, subscription_channel& channel);
+
+        template<typename Q>
+        friend void replace_subscriptions(Q& program, subscription_channel& channel, subscription_list&& subscriptions);
+
+        template<typename Q>
+        friend void free_subscription_slot(Q& program, id_t subscription_id);
+
+        template<typename Q>
+        friend std::size_t compact_channel(Q& program, subscription_channel& channel);
+
+        template<typename Q>
+        friend void remove_channel(Q& program, std::size_t channel_index);
+
+        template<typename Q>
+        friend std::size_t compact_subscriptions(Q& program, std::size_t channel_budget);
+
+        template<typename Q>
+        friend std::size_t compact_subscriptions(Q& program);
+
+        template<typename Q>
+        friend std::size_t get_reclaimed_subscription_count(const Q& program);
+
+        template<typename Q>
+        friend class publish_scope;
 
-        template<typename P>
-        friend void unsubscribe_event(P& program, id_t subscription_id);
+        template<typename T, typename Q>
+        friend void publish_event_parallel(Q& program, thread_pool& pool, const T& event_data, const address& event_address, const std::shared_ptr<addressable>& publisher);
 
-        template<typename T, typename P, typename H>
-        friend unsubscriber<P> subscribe_event5(P& program, id_t subscription_id, const address& address, const std::shared_ptr<addressable>& subscriber, const H& handler);
+        template<typename T, typename Q>
+        friend void publish_queued_events(Q& program, const queued_event<Q>* begin, const queued_event<Q>* end);
 
-        template<typename T, typename P>
-        friend void publish_event(P& program, const T& event_data, const address& address, const std::shared_ptr<addressable>& publisher);
+        template<typename T, typename Q>
+        friend void enqueue_event(Q& program, const T& event_data, const address& event_address, const std::shared_ptr<addressable>& publisher);
+
+        template<typename Q>
+        friend void set_event_coalescing(Q& program, const address& address, bool coalesce);
+
+        template<typename Q>
+        friend std::size_t drain_events(Q& program);
+
+        template<typename Q>
+        friend void observe_property_changes(Q& program, property_store& store, const address& address, const std::shared_ptr<addressable>& publisher);
+
+        template<typename Q>
+        friend std::size_t flush_property_changes(Q& program);
+
+        template<typename Q>
+        friend void set_event_recorder(Q& program, event_recorder* recorder_opt);
+
+        template<typename T, typename Q>
+        friend void record_published_event(Q& program, const T& event_data, const address& event_address);
+
+        template<typename Q>
+        friend void unsubscribe_event(Q& program, id_t subscription_id);
+
+        template<typename T, typename Q, typename H>
+        friend unsubscriber<Q> subscribe_event6(Q& program, id_t subscription_id, const address& address, const std::shared_ptr<addressable>& subscriber, int priority, const H& handler);
+
+        template<typename T, typename Q>
+        friend bool publish_subscriptions(Q& program, const subscription_list& subscriptions, const T& event_data, const address& event_address, const std::shared_ptr<addressable>& publisher);
+
+        template<typename T, typename Q>
+        friend void publish_event(Q& program, const T& event_data, const address& address, const std::shared_ptr<addressable>& publisher);
+
+        template<typename Q>
+        friend void dump_event_stats(const Q& program, std::ostream& stream, std::size_t top_count);
 
     public:
 
@@ -52,88 +202,521 @@ namespace das
 
         eventable() :
             castable(),
-            pred_id(std::make_unique<id_t>()),
+            subscription_slots(),
+            subscription_slots_free(),
+            subscription_slots_external(),
             subscriptions_map(),
-            unsubscription_map()
+            pattern_subscriptions(),
+            channels(),
+            channels_compacted(),
+            subscriptions_reclaimed(),
+            publish_depth(),
+            retired_snapshots(),
+            deferred_events(),
+            event_recorder_opt(),
+            property_changes()
+#ifdef DAS_EVENT_STATS
+            , event_stats()
+#endif
         { }
+
+        ~eventable()
+        {
+            for (VAR* channel : channels) detach_event_waiters(channel->waiters);
+        }
     };
 
+    // Marks the extent of a publish, retiring the subscription snapshots replaced during it once
+    // the outermost publish completes.
+    template<typename P>
+    class publish_scope
+    {
+    private:
+
+        P& program;
+
+    public:
+
+        publish_scope() = delete;
+        publish_scope(const publish_scope&) = delete;
+        publish_scope(publish_scope&&) = delete;
+        publish_scope& operator=(const publish_scope&) = delete;
+        publish_scope& operator=(publish_scope&&) = delete;
+
+        explicit publish_scope(P& program) : program(program)
+        {
+            ++program.publish_depth;
+        }
+
+        ~publish_scope()
+        {
+            if (--program.publish_depth == 0z) program.retired_snapshots.clear();
+        }
+    };
+
+    // Reserve a subscription slot, returning the id that the subscription made in it is to have.
+    // Reserved ids have the complement of their slot index as their x, so they are negative and
+    // never collide with the counting ids a caller may supply instead.
     template<typename P>
     id_t get_subscription_id(P& program)
     {
         CONSTRAIN(P, eventable);
-        VAL& pred_id = *program.pred_id;
-        VAL& succ_id = succ(pred_id);
-        program.pred_id = std::make_unique<id_t>(succ_id);
-        return succ_id;
+        if (program.subscription_slots_free.empty())
+        {
+            program.subscription_slots.push_back(subscription_slot{ one<int64_t>(), nullptr, nullptr });
+            return id_t(~static_cast<int64_t>(pred(program.subscription_slots.size())), one<int64_t>());
+        }
+        VAL slot_index = program.subscription_slots_free.back();
+        program.subscription_slots_free.pop_back();
+        return id_t(~static_cast<int64_t>(slot_index), program.subscription_slots[slot_index].generation);
     }
 
+    // Try to get the subscription slot that a subscription id refers to, failing when the id is
+    // stale or was never issued. The slots of ids supplied by the caller are found by hash.
     template<typename P>
-    void unsubscribe_event(P& program, id_t subscription_id)
+    subscription_slot* try_get_subscription_slot(P& program, id_t subscription_id)
     {
         CONSTRAIN(P, eventable);
-        VAL& unsubscription_opt = program.unsubscription_map.find(subscription_id);
-        if (unsubscription_opt != std::end(program.unsubscription_map))
+        if (subscription_id.x >= 0)
         {
-            VAL& subscriptions_opt = program.subscriptions_map.find(unsubscription_opt->second.first);
-            if (subscriptions_opt != std::end(program.subscriptions_map))
+            VAL slot_opt = program.subscription_slots_external.find(subscription_id);
+            return slot_opt != std::end(program.subscription_slots_external) ? &slot_opt->second : nullptr;
+        }
+        VAL slot_index = static_cast<std::size_t>(~subscription_id.x);
+        if (slot_index >= program.subscription_slots.size()) return nullptr;
+        VAR& slot = program.subscription_slots[slot_index];
+        if (slot.generation != subscription_id.y) return nullptr;
+        return &slot;
+    }
+
+    template<typename P>
+    subscription_channel& get_or_add_channel(P& program, const channel_key& channel_key)
+    {
+        CONSTRAIN(P, eventable);
+        VAR& channels =
+            is_address_pattern(channel_key.address) ?
+            get_or_add_trie_value(program.pattern_subscriptions, channel_key.address) :
+            program.subscriptions_map[channel_key.address];
+        VAL channel_count = channels.size();
+        VAR& channel = find_or_add_channel(channels, channel_key);
+        if (channels.size() != channel_count) program.channels.push_back(&channel);
+        return channel;
+    }
+
+    // Get the subscriptions of a channel for modification. Outside of any publish nothing can be
+    // borrowing the channel's snapshot, so it is modified in place. Otherwise it is first replaced
+    // by a copy, leaving the original to the publishes that borrowed it.
+    template<typename P>
+    subscription_list& get_subscriptions_writable(P& program, subscription_channel& channel)
+    {
+        CONSTRAIN(P, eventable);
+        if (program.publish_depth != 0z) replace_subscriptions(program, channel, subscription_list(*channel.subscriptions));
+        return *channel.subscriptions;
+    }
+
+    template<typename P>
+    void replace_subscriptions(P& program, subscription_channel& channel, subscription_list&& subscriptions)
+    {
+        CONSTRAIN(P, eventable);
+        VAR snapshot_mvb = std::make_unique<subscription_list>(std::move(subscriptions));
+        if (program.publish_depth != 0z) program.retired_snapshots.push_back(std::move(channel.subscriptions));
+        channel.subscriptions = std::move(snapshot_mvb);
+    }
+
+    // Free the slot of a subscription, advancing its generation so that the subscription's id can
+    // no longer reach it, or removing it if its id was supplied by the caller. The subscription's
+    // statistics, if gathered, go with it.
+    template<typename P>
+    void free_subscription_slot(P& program, id_t subscription_id)
+    {
+        CONSTRAIN(P, eventable);
+#ifdef DAS_EVENT_STATS
+        remove_subscription_stats(program.event_stats, subscription_id);
+#endif
+        if (subscription_id.x >= 0)
+        {
+            program.subscription_slots_external.erase(subscription_id);
+            return;
+        }
+        VAL slot_index = static_cast<std::size_t>(~subscription_id.x);
+        VAR& slot = program.subscription_slots[slot_index];
+        slot = subscription_slot{ succ(slot.generation), nullptr, nullptr };
+        program.subscription_slots_free.push_back(slot_index);
+    }
+
+    // Remove the unsubscribed subscriptions of a channel along with those whose subscribers have
+    // died, returning how many of the latter were reclaimed and adding them to the program's
+    // count.
+    template<typename P>
+    std::size_t compact_channel(P& program, subscription_channel& channel)
+    {
+        CONSTRAIN(P, eventable);
+        std::size_t reclaimed = 0;
+        subscription_list subscriptions{};
+        for (VAL& subscription : *channel.subscriptions)
+        {
+            if (subscription->unsubscribed) continue;
+            if (subscription->subscriber_opt.expired())
             {
-                VAR& subscriptions = *subscriptions_opt->second;
-                subscriptions.erase(
-                    std::remove_if(
-                    std::begin(subscriptions),
-                    std::end(subscriptions),
-                    [unsubscription_opt](VAL& subscription)
-                { return subscription->subscriber_opt.lock().get() == unsubscription_opt->second.second.lock().get(); }));
-                program.unsubscription_map.erase(unsubscription_opt);
+                free_subscription_slot(program, subscription->id);
+                ++reclaimed;
+                continue;
             }
+            subscriptions.push_back(subscription);
         }
+        if (subscriptions.size() != channel.subscriptions->size()) replace_subscriptions(program, channel, std::move(subscriptions));
+        channel.unsubscribed_count = 0z;
+        program.subscriptions_reclaimed += reclaimed;
+        return reclaimed;
     }
 
-    template<typename T, typename P, typename H>
-    unsubscriber<P> subscribe_event5(P& program, id_t subscription_id, const address& address, const std::shared_ptr<addressable>& subscriber, const H& handler)
+    // Remove an empty channel, along with its address' entry once the address has no channels
+    // left. This is only done outside of any publish, as a publish may be holding the channel. The
+    // program's last channel takes the removed channel's place in its list.
+    template<typename P>
+    void remove_channel(P& program, std::size_t channel_index)
     {
         CONSTRAIN(P, eventable);
-        VAR subscription_detail_mvb = cast_unique<castable>(std::make_unique<subscription_detail<T, P>>(handler));
-        VAR subscriptions_opt = program.subscriptions_map.find(address);
-        if (subscriptions_opt != std::end(program.subscriptions_map))
+        VAL* channel = program.channels[channel_index];
+        VAL channel_address = channel->address;
+        VAL pattern = is_address_pattern(channel_address);
+        VAL map_entry_opt = pattern ? std::end(program.subscriptions_map) : program.subscriptions_map.find(channel_address);
+        VAR* channels_opt =
+            pattern ?
+            try_get_trie_value(program.pattern_subscriptions, channel_address) :
+            map_entry_opt != std::end(program.subscriptions_map) ? &map_entry_opt->second : nullptr;
+        program.channels[channel_index] = program.channels.back();
+        program.channels.pop_back();
+        if (!channels_opt) return;
+        VAR& channels = *channels_opt;
+        channels.erase(std::remove_if(std::begin(channels), std::end(channels), [channel](VAL& channel_other) { return channel_other.get() == channel; }), std::end(channels));
+        if (!channels.empty()) return;
+        if (pattern) remove_trie_value(program.pattern_subscriptions, channel_address);
+        else program.subscriptions_map.erase(map_entry_opt);
+    }
+
+    // Compact up to the given number of channels, continuing from where the previous call left off,
+    // and returning how many subscriptions of dead subscribers were reclaimed. Outside of any
+    // publish, the channels left with neither subscriptions nor waiters are removed.
+    template<typename P>
+    std::size_t compact_subscriptions(P& program, std::size_t channel_budget)
+    {
+        CONSTRAIN(P, eventable);
+        std::size_t reclaimed = 0;
+        VAL channel_count = std::min(channel_budget, program.channels.size());
+        for (std::size_t i = 0; i < channel_count && !program.channels.empty(); ++i)
         {
-            VAL& subscription = std::make_shared<das::subscription>(subscription_id, subscriber, std::move(subscription_detail_mvb));
-            subscriptions_opt->second->push_back(subscription);
+            if (program.channels_compacted >= program.channels.size()) program.channels_compacted = 0z;
+            VAL channel_index = program.channels_compacted++;
+            VAR& channel = *program.channels[channel_index];
+            reclaimed += compact_channel(program, channel);
+            if (program.publish_depth == 0z && channel.subscriptions->empty() && !channel.waiters.head_opt)
+            {
+                // the channel that takes the removed one's place is compacted next
+                remove_channel(program, channel_index);
+                program.channels_compacted = channel_index;
+            }
         }
-        else
+        return reclaimed;
+    }
+
+    // Compact every channel, returning how many subscriptions of dead subscribers were reclaimed.
+    template<typename P>
+    std::size_t compact_subscriptions(P& program)
+    {
+        CONSTRAIN(P, eventable);
+        return compact_subscriptions(program, program.channels.size());
+    }
+
+    // Get how many subscriptions of dead subscribers the program has reclaimed in all, whether by
+    // compact_subscriptions or by the compaction of a channel on unsubscribing.
+    template<typename P>
+    std::size_t get_reclaimed_subscription_count(const P& program)
+    {
+        CONSTRAIN(P, eventable);
+        return program.subscriptions_reclaimed;
+    }
+
+    template<typename P>
+    void unsubscribe_event(P& program, id_t subscription_id)
+    {
+        CONSTRAIN(P, eventable);
+        VAR* slot_opt = try_get_subscription_slot(program, subscription_id);
+        if (slot_opt && slot_opt->subscription_opt)
         {
-            VAL& subscription = std::make_shared<das::subscription>(subscription_id, subscriber, std::move(subscription_detail_mvb));
-            VAR subscriptions_mvb = std::make_unique<subscription_list>();
-            subscriptions_mvb->push_back(subscription);
-            program.subscriptions_map.insert(std::make_pair(address::address(address), std::move(subscriptions_mvb)));
+            // mark the subscription, compacting its channel once most of it is marked
+            VAR& channel = *slot_opt->channel_opt;
+            slot_opt->subscription_opt->unsubscribed = true;
+            free_subscription_slot(program, subscription_id);
+            if (++channel.unsubscribed_count * 2z > channel.subscriptions->size()) compact_channel(program, channel);
         }
-        program.unsubscription_map.insert(std::make_pair(subscription_id, std::make_pair(address, subscriber)));
+    }
+
+    template<typename T, typename P, typename H>
+    unsubscriber<P> subscribe_event6(P& program, id_t subscription_id, const address& address, const std::shared_ptr<addressable>& subscriber, int priority, const H& handler)
+    {
+        CONSTRAIN(P, eventable);
+        static_assert(std::is_constructible<das::handler<T, P>, H>::value, "Handler must be callable with the subscription's event type.");
+        VAR* slot_opt =
+            subscription_id.x >= 0 ?
+            &program.subscription_slots_external.emplace(subscription_id, subscription_slot{ zero<int64_t>(), nullptr, nullptr }).first->second :
+            try_get_subscription_slot(program, subscription_id);
+        if (!slot_opt || slot_opt->subscription_opt) throw std::logic_error("Subscription id must be supplied by the caller or reserved by get_subscription_id, and not yet used.");
+        VAR subscription_detail_mvb = cast_unique<castable>(std::make_unique<subscription_detail<T, P>>(handler));
+        VAL& subscription = std::make_shared<das::subscription>(subscription_id, priority, subscriber, std::move(subscription_detail_mvb));
+        VAR& channel = get_or_add_channel(program, das::channel_key(address, get_event_type_key<T>()));
+        VAR& subscriptions = get_subscriptions_writable(program, channel);
+        VAL position = std::upper_bound(
+            std::begin(subscriptions),
+            std::end(subscriptions),
+            priority,
+            [](int priority, VAL& subscription) { return priority > subscription->priority; });
+        subscriptions.insert(position, subscription);
+        *slot_opt = subscription_slot{ slot_opt->generation, subscription.get(), &channel };
+#ifdef DAS_EVENT_STATS
+        add_subscription_stats(program.event_stats, subscription_id, address);
+#endif
         return [subscription_id](P& program) { unsubscribe_event(program, subscription_id); };
     }
 
+    template<typename T, typename P, typename H>
+    unsubscriber<P> subscribe_event5(P& program, id_t subscription_id, const address& address, const std::shared_ptr<addressable>& subscriber, const H& handler)
+    {
+        CONSTRAIN(P, eventable);
+        return subscribe_event6<T, P>(program, subscription_id, address, subscriber, 0, handler);
+    }
+
+    template<typename T, typename P, typename H>
+    unsubscriber<P> subscribe_event(P& program, const address& address, const std::shared_ptr<addressable>& subscriber, int priority, const H& handler)
+    {
+        CONSTRAIN(P, eventable);
+        return subscribe_event6<T, P>(program, get_subscription_id(program), address, subscriber, priority, handler);
+    }
+
     template<typename T, typename P, typename H>
     unsubscriber<P> subscribe_event(P& program, const address& address, const std::shared_ptr<addressable>& subscriber, const H& handler)
     {
         CONSTRAIN(P, eventable);
-        return subscribe_event5<T, P>(program, get_subscription_id(program), address, subscriber, handler);
+        return subscribe_event6<T, P>(program, get_subscription_id(program), address, subscriber, 0, handler);
+    }
+
+    template<typename T, typename P>
+    bool publish_subscriptions(P& program, const subscription_list& subscriptions, const T& event_data, const address& event_address, const std::shared_ptr<addressable>& publisher)
+    {
+        CONSTRAIN(P, eventable);
+        for (VAL& subscription : subscriptions)
+        {
+#ifdef DAS_EVENT_STATS
+            VAL start = std::chrono::steady_clock::now();
+            bool handled = false;
+            VAL cascade = publish_subscription<T, P>(*subscription, event_data, event_address, publisher, program, handled);
+            if (handled) record_event_delivery(program.event_stats, subscription->id, event_address, std::chrono::steady_clock::now() - start, cascade);
+#else
+            VAL cascade = publish_subscription<T, P>(*subscription, event_data, event_address, publisher, program);
+#endif
+            if (!cascade) return false;
+        }
+        return true;
+    }
+
+    // Set the recorder that the program's published events are recorded to, if any. The recorder
+    // must outlive its use by the program.
+    template<typename P>
+    void set_event_recorder(P& program, event_recorder* recorder_opt)
+    {
+        CONSTRAIN(P, eventable);
+        program.event_recorder_opt = recorder_opt;
+    }
+
+    template<typename T, typename P>
+    void record_published_event(P& program, const T& event_data, const address& event_address)
+    {
+        CONSTRAIN(P, eventable);
+        if (program.event_recorder_opt)
+            record_event(*program.event_recorder_opt, event_data, event_address, std::integral_constant<bool, event_serializer<T>::value>());
+    }
+
+    // Publish an event to the subscriptions of a channel, then resume the channel's waiters unless
+    // a subscription cancelled the event's propagation.
+    template<typename T, typename P>
+    bool publish_channel(P& program, subscription_channel& channel, const T& event_data, const address& event_address, const std::shared_ptr<addressable>& publisher)
+    {
+        CONSTRAIN(P, eventable);
+        if (!publish_subscriptions<T, P>(program, *channel.subscriptions, event_data, event_address, publisher)) return false;
+        resume_event_waiters(channel.waiters, event_data, event_address, publisher);
+        return true;
     }
 
     template<typename T, typename P>
     void publish_event(P& program, const T& event_data, const address& event_address, const std::shared_ptr<addressable>& publisher)
     {
         CONSTRAIN(P, eventable);
-        VAL& subscriptions_opt = program.subscriptions_map.find(event_address);
-        if (subscriptions_opt != std::end(program.subscriptions_map))
+        const publish_scope<P> scope(program);
+#ifdef DAS_EVENT_STATS
+        record_event_publish(program.event_stats, event_address);
+#endif
+        record_published_event(program, event_data, event_address);
+        VAL event_type = get_event_type_key<T>();
+        VAL& channels_opt = program.subscriptions_map.find(event_address);
+        if (channels_opt != std::end(program.subscriptions_map))
+        {
+            VAR* channel_opt = try_find_channel(channels_opt->second, event_type);
+            if (channel_opt && !publish_channel<T, P>(program, *channel_opt, event_data, event_address, publisher)) return;
+        }
+        match_trie_values(program.pattern_subscriptions, event_address, [&](VAL& channels)
         {
-            VAL subscriptions_copy = *subscriptions_opt->second;
-            for (VAL& subscription : subscriptions_copy)
+            VAR* channel_opt = try_find_channel(channels, event_type);
+            return !channel_opt || publish_channel<T, P>(program, *channel_opt, event_data, event_address, publisher);
+        });
+    }
+
+    // Publish an event to each of its subscriptions in parallel across a thread pool, returning
+    // once every handler has returned. Any waiters on the event are then resumed on the calling
+    // thread.
+    //
+    // As the handlers run concurrently, none of them may cancel the event's propagation, so their
+    // return values are ignored. They must also be safe to run concurrently with each other, and
+    // must not publish, enqueue, subscribe, or unsubscribe on the program until the publish has
+    // returned.
+    //
+    // With DAS_EVENT_STATS defined, the publish is counted, but its handler latencies are not.
+    template<typename T, typename P>
+    void publish_event_parallel(P& program, thread_pool& pool, const T& event_data, const address& event_address, const std::shared_ptr<addressable>& publisher)
+    {
+        CONSTRAIN(P, eventable);
+        const publish_scope<P> scope(program);
+#ifdef DAS_EVENT_STATS
+        record_event_publish(program.event_stats, event_address);
+#endif
+        record_published_event(program, event_data, event_address);
+        VAL event_type = get_event_type_key<T>();
+        std::vector<subscription_channel*> channels_matched{};
+        std::vector<const subscription*> subscriptions_matched{};
+        VAL add_channel = [&](subscription_channel* channel_opt)
+        {
+            if (channel_opt)
             {
-                VAL cascade = publish_subscription<T, P>(*subscription, event_data, event_address, publisher, program);
+                channels_matched.push_back(channel_opt);
+                for (VAL& subscription : *channel_opt->subscriptions)
+                    subscriptions_matched.push_back(subscription.get());
+            }
+        };
+        VAL& channels_opt = program.subscriptions_map.find(event_address);
+        if (channels_opt != std::end(program.subscriptions_map)) add_channel(try_find_channel(channels_opt->second, event_type));
+        match_trie_values(program.pattern_subscriptions, event_address, [&](VAL& channels)
+        {
+            add_channel(try_find_channel(channels, event_type));
+            return true;
+        });
+        parallel_for(pool, subscriptions_matched.size(), [&](std::size_t index)
+        {
+            publish_subscription<T, P>(*subscriptions_matched[index], event_data, event_address, publisher, program);
+        });
+        for (VAR* channel : channels_matched) resume_event_waiters(channel->waiters, event_data, event_address, publisher);
+    }
+
+    template<typename T, typename P>
+    void publish_queued_events(P& program, const queued_event<P>* begin, const queued_event<P>* end)
+    {
+        CONSTRAIN(P, eventable);
+        const publish_scope<P> scope(program);
+
+        // find the subscriptions common to the batch just once
+        VAL& event_address = begin->address;
+        std::vector<std::pair<const subscription_list*, subscription_channel*>> channels_matched{};
+        VAL& channels_opt = program.subscriptions_map.find(event_address);
+        if (channels_opt != std::end(program.subscriptions_map))
+        {
+            VAR* channel_opt = try_find_channel(channels_opt->second, begin->event_type);
+            if (channel_opt) channels_matched.emplace_back(channel_opt->subscriptions.get(), channel_opt);
+        }
+        match_trie_values(program.pattern_subscriptions, event_address, [&](VAL& channels)
+        {
+            VAR* channel_opt = try_find_channel(channels, begin->event_type);
+            if (channel_opt) channels_matched.emplace_back(channel_opt->subscriptions.get(), channel_opt);
+            return true;
+        });
+
+        for (VAR* event = begin; event != end; ++event)
+        {
+#ifdef DAS_EVENT_STATS
+            record_event_publish(program.event_stats, event_address);
+#endif
+            VAL& event_data = *static_cast<const T*>(event->data);
+            record_published_event(program, event_data, event_address);
+            for (VAL& channel : channels_matched)
+            {
+                VAL cascade = publish_subscriptions<T, P>(program, *channel.first, event_data, event_address, event->publisher);
                 if (!cascade) break;
+                resume_event_waiters(channel.second->waiters, event_data, event_address, event->publisher);
             }
         }
     }
+
+    // Defer the publishing of an event until the program next calls drain_events.
+    template<typename T, typename P>
+    void enqueue_event(P& program, const T& event_data, const address& event_address, const std::shared_ptr<addressable>& publisher)
+    {
+        CONSTRAIN(P, eventable);
+        enqueue_queued_event<T, P>(program.deferred_events, event_data, event_address, publisher, &publish_queued_events<T, P>);
+    }
+
+    // Set whether the events deferred to an address coalesce, such that only the latest event of
+    // each type enqueued to the address is published per drain.
+    template<typename P>
+    void set_event_coalescing(P& program, const address& address, bool coalesce)
+    {
+        CONSTRAIN(P, eventable);
+        set_queue_coalescing(program.deferred_events, address, coalesce);
+    }
+
+    // Publish the deferred events, returning how many were published.
+    //
+    // Events are published in batches grouped by address and event type, with events in each
+    // batch published in the order they were enqueued. As the subscriptions of a batch are found
+    // once for the whole batch, subscribing or unsubscribing during a batch takes effect from the
+    // next batch. Events enqueued during the drain are deferred to the next drain.
+    template<typename P>
+    std::size_t drain_events(P& program)
+    {
+        CONSTRAIN(P, eventable);
+        return drain_queued_events(program.deferred_events, program);
+    }
+
+    // Track the changes of a property store such that each flush of the program publishes one
+    // property_change per changed property at the given address with the property's name
+    // appended. The store must be unobserved or destroyed before the program.
+    template<typename P>
+    void observe_property_changes(P& program, property_store& store, const address& address, const std::shared_ptr<addressable>& publisher)
+    {
+        CONSTRAIN(P, eventable);
+        observe_property_changes(store, program.property_changes, address, publisher);
+    }
+
+    // Publish a property_change for each property of the program's observed stores that was
+    // written since the last flush, returning how many were published. Properties written by the
+    // handlers of a flush are published by the next flush.
+    template<typename P>
+    std::size_t flush_property_changes(P& program)
+    {
+        CONSTRAIN(P, eventable);
+        return flush_property_changes(program.property_changes, [&program](const property_change& change, const address& event_address, const std::shared_ptr<addressable>& publisher)
+        {
+            publish_event(program, change, event_address, publisher);
+        });
+    }
+
+#ifdef DAS_EVENT_STATS
+    // Write the program's event statistics as CSV tables, being the most published addresses and
+    // the subscriptions with the slowest handlers by 99th percentile latency, up to the given count
+    // of each.
+    template<typename P>
+    void dump_event_stats(const P& program, std::ostream& stream, std::size_t top_count)
+    {
+        CONSTRAIN(P, eventable);
+        write_event_stats(stream, program.event_stats, top_count);
+    }
+#endif
 }
 
 #endif
@@ -0,0 +1,237 @@
+#ifndef DAS_EVENTABLE_CONCURRENT_HPP
+#define DAS_EVENTABLE_CONCURRENT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <functional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <stdexcept>
+
+#include "prelude.hpp"
+#include "id.hpp"
+#include "castable.hpp"
+#include "addressable.hpp"
+#include "address.hpp"
+#include "address_trie.hpp"
+#include "subscription.hpp"
+#include "eventable.hpp"
+#include "epoch.hpp"
+
+namespace das
+{
+    // A channel of subscriptions that may be read by any number of threads while it is written.
+    // Its subscriptions are an immutable list that writers replace rather than mutate.
+    class channel_concurrent
+    {
+    private:
+
+        std::atomic<const subscription_list*> subscriptions;
+
+    protected:
+
+        friend const subscription_list& borrow_subscriptions_concurrent(const channel_concurrent& channel);
+        friend const subscription_list* exchange_subscriptions_concurrent(channel_concurrent& channel, const subscription_list* subscriptions);
+
+    public:
+
+        CONSTRAINT(channel_concurrent);
+
+        channel_concurrent() : subscriptions(new subscription_list()) { }
+        channel_concurrent(const channel_concurrent&) = delete;
+        channel_concurrent(channel_concurrent&&) = delete;
+        channel_concurrent& operator=(const channel_concurrent&) = delete;
+        channel_concurrent& operator=(channel_concurrent&&) = delete;
+
+        ~channel_concurrent()
+        {
+            delete subscriptions.load();
+        }
+    };
+
+    // Borrow the subscriptions of a channel. Must be called within an epoch_guard, and the
+    // subscriptions must not be used once the guard is released.
+    inline const subscription_list& borrow_subscriptions_concurrent(const channel_concurrent& channel)
+    {
+        return *channel.subscriptions.load();
+    }
+
+    // Replace the subscriptions of a channel, returning the replaced subscriptions for retirement.
+    inline const subscription_list* exchange_subscriptions_concurrent(channel_concurrent& channel, const subscription_list* subscriptions)
+    {
+        return channel.subscriptions.exchange(subscriptions);
+    }
+
+    // The channels of each address, as an immutable map that writers replace rather than mutate.
+    using channels_map_concurrent = std::unordered_map<address, std::vector<std::pair<event_type_key, channel_concurrent*>>>;
+
+    // A program mixin like eventable, except that events may be published from any number of
+    // threads at once.
+    //
+    // Publishing takes no locks. It reads immutable snapshots of the subscriptions inside an epoch
+    // guard, and snapshots that writers replace are reclaimed only once no publish can still be
+    // reading them. Subscribing and unsubscribing serialize with each other on a writer lock, but
+    // never wait on publishers. Handlers may run on any publishing thread at once, so they must
+    // be thread-safe, and that includes what they do with the program they are given.
+    //
+    // Only exact addresses may be subscribed to, not address patterns, as publishing looks its
+    // address up by hash alone. Subscribing to a pattern throws.
+    template<typename P>
+    class eventable_concurrent : public castable
+    {
+    private:
+
+        std::mutex writer_mutex;
+        std::atomic<const channels_map_concurrent*> channels_map;
+        std::vector<std::unique_ptr<channel_concurrent>> channels;
+        std::unordered_map<id_t, channel_concurrent*> unsubscription_map;
+        std::vector<std::pair<std::uint64_t, std::shared_ptr<const void>>> retired;
+        id_generator subscription_ids;
+
+    protected:
+
+        ENABLE_CAST(eventable_concurrent<P>, castable);
+
+        template<typename A>
+        friend void retire_concurrent(eventable_concurrent<A>& program, std::shared_ptr<const void> retiree);
+
+        template<typename A>
+        friend channel_concurrent& get_or_add_channel_concurrent(eventable_concurrent<A>& program, const address& address, event_type_key event_type);
+
+        template<typename Q>
+        friend void unsubscribe_event_concurrent(Q& program, id_t subscription_id);
+
+        template<typename T, typename Q, typename H>
+        friend unsubscriber<Q> subscribe_event_concurrent(Q& program, const address& address, const std::shared_ptr<addressable>& subscriber, const H& handler);
+
+        template<typename T, typename Q>
+        friend void publish_event_concurrent(Q& program, const T& event_data, const address& event_address, const std::shared_ptr<addressable>& publisher);
+
+    public:
+
+        CONSTRAINT(eventable_concurrent);
+
+        eventable_concurrent() :
+            castable(),
+            writer_mutex(),
+            channels_map(new channels_map_concurrent()),
+            channels(),
+            unsubscription_map(),
+            retired(),
+            subscription_ids()
+        { }
+
+        ~eventable_concurrent()
+        {
+            delete channels_map.load();
+        }
+    };
+
+    // Retire data replaced by a write, and reclaim whatever retired data no publish can still be
+    // reading. Must be called with the writer lock held.
+    template<typename P>
+    void retire_concurrent(eventable_concurrent<P>& program, std::shared_ptr<const void> retiree)
+    {
+        program.retired.emplace_back(advance_epoch(), std::move(retiree));
+        program.retired.erase(
+            std::remove_if(
+                std::begin(program.retired),
+                std::end(program.retired),
+                [](VAL& retiree) { return get_epoch_reclaimable(retiree.first); }),
+            std::end(program.retired));
+    }
+
+    // Get the channel of the given address and event type, adding it if there is none. Must be
+    // called with the writer lock held.
+    template<typename P>
+    channel_concurrent& get_or_add_channel_concurrent(eventable_concurrent<P>& program, const address& address, event_type_key event_type)
+    {
+        VAL* channels_map = program.channels_map.load();
+        VAL channels_opt = channels_map->find(address);
+        if (channels_opt != std::end(*channels_map))
+            for (VAL& channel : channels_opt->second)
+                if (channel.first == event_type)
+                    return *channel.second;
+        program.channels.push_back(std::make_unique<channel_concurrent>());
+        VAR* channel = program.channels.back().get();
+        VAR channels_map_mvb = std::make_unique<channels_map_concurrent>(*channels_map);
+        (*channels_map_mvb)[address].emplace_back(event_type, channel);
+        program.channels_map.store(channels_map_mvb.release());
+        retire_concurrent(program, std::shared_ptr<const void>(channels_map));
+        return *channel;
+    }
+
+    template<typename P>
+    void unsubscribe_event_concurrent(P& program, id_t subscription_id)
+    {
+        CONSTRAIN(P, eventable_concurrent);
+        std::lock_guard<std::mutex> lock(program.writer_mutex);
+        VAL unsubscription_opt = program.unsubscription_map.find(subscription_id);
+        if (unsubscription_opt != std::end(program.unsubscription_map))
+        {
+            VAR& channel = *unsubscription_opt->second;
+            VAR subscriptions_mvb = std::make_unique<subscription_list>(borrow_subscriptions_concurrent(channel));
+            subscriptions_mvb->erase(
+                std::remove_if(
+                    std::begin(*subscriptions_mvb),
+                    std::end(*subscriptions_mvb),
+                    [subscription_id](VAL& subscription) { return subscription->id == subscription_id; }),
+                std::end(*subscriptions_mvb));
+            VAL* subscriptions_retired = exchange_subscriptions_concurrent(channel, subscriptions_mvb.release());
+            retire_concurrent(program, std::shared_ptr<const void>(subscriptions_retired));
+            program.unsubscription_map.erase(unsubscription_opt);
+        }
+    }
+
+    template<typename T, typename P, typename H>
+    unsubscriber<P> subscribe_event_concurrent(P& program, const address& address, const std::shared_ptr<addressable>& subscriber, const H& handler)
+    {
+        CONSTRAIN(P, eventable_concurrent);
+        static_assert(std::is_constructible<das::handler<T, P>, H>::value, "Handler must be callable with the subscription's event type.");
+        if (is_address_pattern(address)) throw std::logic_error("Concurrent subscriptions must be to exact addresses rather than address patterns.");
+        VAL subscription_id = generate_id(program.subscription_ids);
+        VAR subscription_detail_mvb = cast_unique<castable>(std::make_unique<subscription_detail<T, P>>(handler));
+        VAL& subscription = std::make_shared<das::subscription>(subscription_id, 0, subscriber, std::move(subscription_detail_mvb));
+        std::lock_guard<std::mutex> lock(program.writer_mutex);
+        VAR& channel = get_or_add_channel_concurrent(program, address, get_event_type_key<T>());
+        VAR subscriptions_mvb = std::make_unique<subscription_list>(borrow_subscriptions_concurrent(channel));
+        subscriptions_mvb->push_back(subscription);
+        VAL* subscriptions_retired = exchange_subscriptions_concurrent(channel, subscriptions_mvb.release());
+        retire_concurrent(program, std::shared_ptr<const void>(subscriptions_retired));
+        program.unsubscription_map.insert(std::make_pair(subscription_id, &channel));
+        return [subscription_id](P& program) { unsubscribe_event_concurrent(program, subscription_id); };
+    }
+
+    template<typename T, typename P>
+    void publish_event_concurrent(P& program, const T& event_data, const address& event_address, const std::shared_ptr<addressable>& publisher)
+    {
+        CONSTRAIN(P, eventable_concurrent);
+        const epoch_guard guard{};
+        VAL* channels_map = program.channels_map.load();
+        VAL channels_opt = channels_map->find(event_address);
+        if (channels_opt != std::end(*channels_map))
+        {
+            VAL event_type = get_event_type_key<T>();
+            for (VAL& channel : channels_opt->second)
+            {
+                if (channel.first == event_type)
+                {
+                    for (VAL& subscription : borrow_subscriptions_concurrent(*channel.second))
+                    {
+                        VAL cascade = publish_subscription<T, P>(*subscription, event_data, event_address, publisher, program);
+                        if (!cascade) break;
+                    }
+                    break;
+                }
+            }
+        }
+    }
+}
+
+#endif
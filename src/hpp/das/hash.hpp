@@ -2,6 +2,7 @@
 #define das_hash_hpp
 
 #include <cstddef>
+#include <cstdint>
 #include <numeric>
 #include <functional>
 
@@ -9,6 +10,15 @@
 
 namespace das
 {
+    // Get the 64-bit FNV-1a hash of a string. Being constexpr, it can hash string literals at
+    // compile time.
+    constexpr std::uint64_t get_hash_fnv1a(const char* str, std::size_t size)
+    {
+        std::uint64_t hash = 14695981039346656037ull;
+        for (std::size_t i = 0; i < size; ++i) hash = (hash ^ static_cast<unsigned char>(str[i])) * 1099511628211ull;
+        return hash;
+    }
+
     // Get the hash of a T value.
     template<typename T>
     std::size_t get_hash(const T& t)
@@ -16,11 +26,46 @@ namespace das
         return std::hash<T>()(t);
     }
 
-    // Get the hash of a container in terms of its content.
+    // Mix the bits of a hash so that every bit of the input affects every bit of the output, as
+    // does the finalizer of MurmurHash3.
+    constexpr std::uint64_t mix_hash(std::uint64_t hash)
+    {
+        hash = (hash ^ (hash >> 33)) * 0xFF51AFD7ED558CCDull;
+        hash = (hash ^ (hash >> 33)) * 0xC4CEB9FE1A85EC53ull;
+        return hash ^ (hash >> 33);
+    }
+
+    // The odd multiplier by which a sequence hash is shifted along for each element appended.
+    constexpr std::uint64_t sequence_hash_multiplier = 0x9E3779B97F4A7C15ull;
+
+    // Extend the hash of a sequence with the hash of an element appended to it.
+    //
+    // A sequence hash is a polynomial in the mixed hashes of its elements, so it is sensitive to
+    // their order and does not cancel out repeated elements. The hash of the empty sequence is 0.
+    constexpr std::size_t extend_hash(std::size_t sequence_hash, std::size_t element_hash)
+    {
+        return static_cast<std::size_t>(sequence_hash * sequence_hash_multiplier + mix_hash(element_hash));
+    }
+
+    // Get the hash of a sequence appended to another from just their hashes and the size of the
+    // appended one, in time logarithmic in that size rather than linear in the whole.
+    constexpr std::size_t concat_hash(std::size_t left_hash, std::size_t right_hash, std::size_t right_size)
+    {
+        std::uint64_t power = 1;
+        std::uint64_t base = sequence_hash_multiplier;
+        for (; right_size != 0; right_size >>= 1)
+        {
+            if (right_size & 1) power *= base;
+            base *= base;
+        }
+        return static_cast<std::size_t>(left_hash * power + right_hash);
+    }
+
+    // Get the hash of a sequence in terms of its content.
     template<typename T, typename It>
     std::size_t get_hash_range(const It& begin, const It& end)
     {
-        return std::accumulate(begin, end, 0z, [](VAR acc, VAL& t) { return get_hash<T>(t) ^ acc; });
+        return std::accumulate(begin, end, std::size_t(0), [](std::size_t acc, VAL& t) { return extend_hash(acc, get_hash<T>(t)); });
     }
 }
 
@@ -3,10 +3,12 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <atomic>
 #include <stdexcept>
 #include <limits>
 
 #include "prelude.hpp"
+#include "hash.hpp"
 
 namespace das
 {
@@ -29,7 +31,7 @@ namespace das
         constexpr id_t(int64_t x, int64_t y) : x(x), y(y) { }
         constexpr bool operator==(const id_t& that) const { return x == that.x && y == that.y; }
         static constexpr id_t invalid() { return id_t(); }
-        explicit operator std::size_t() const { return x ^ y; }
+        explicit operator std::size_t() const { return static_cast<std::size_t>(mix_hash(static_cast<std::uint64_t>(x) ^ static_cast<std::uint64_t>(y) * sequence_hash_multiplier)); }
     };
 
     template<>
@@ -48,6 +50,76 @@ namespace das
         }
         return id_t(succ(id.x), id.y);
     }
+
+    // Get a serial number unique to each id generator in the process, never 0.
+    inline std::uint64_t get_id_generator_serial()
+    {
+        static std::atomic<std::uint64_t> serial(0);
+        return ++serial;
+    }
+
+    // Generates ids unique to the generator from any number of threads, without locking or
+    // allocating. Each thread claims a contiguous block of ids with a single atomic add, then hands
+    // out ids from its block without touching shared state, so concurrent threads don't contend.
+    // A thread keeps a block for each of the last few generators it used, so alternating between
+    // generators doesn't discard blocks. Ids are therefore unique but not ordered across threads.
+    class id_generator
+    {
+    private:
+
+        static constexpr std::int64_t block_size = 1024;
+        static constexpr std::size_t blocks_per_thread = 4;
+
+        const std::uint64_t serial;
+        std::atomic<std::int64_t> block_next;
+
+    protected:
+
+        friend id_t generate_id(id_generator& generator);
+
+    public:
+
+        CONSTRAINT(id_generator);
+
+        id_generator() : serial(get_id_generator_serial()), block_next(1) { }
+        id_generator(const id_generator&) = delete;
+        id_generator(id_generator&&) = delete;
+        id_generator& operator=(const id_generator&) = delete;
+        id_generator& operator=(id_generator&&) = delete;
+    };
+
+    // Generate a valid id, unique among those of the generator.
+    inline id_t generate_id(id_generator& generator)
+    {
+        // a thread keeps its blocks by generator serial rather than address so that a new
+        // generator at a dead one's address can't reuse its ids, replacing them in turn
+        struct id_block { std::uint64_t serial; std::int64_t next; std::int64_t end; };
+        static thread_local id_block blocks[id_generator::blocks_per_thread]{};
+        static thread_local std::size_t block_replaced = 0;
+        id_block* block_opt = nullptr;
+        for (VAR& block : blocks)
+        {
+            if (block.serial == generator.serial)
+            {
+                block_opt = &block;
+                break;
+            }
+        }
+        if (!block_opt)
+        {
+            block_opt = &blocks[block_replaced];
+            block_replaced = (block_replaced + 1) % id_generator::blocks_per_thread;
+            *block_opt = id_block{ generator.serial, 0, 0 };
+        }
+        VAR& block = *block_opt;
+        if (block.next == block.end)
+        {
+            VAL begin = generator.block_next.fetch_add(id_generator::block_size, std::memory_order_relaxed);
+            block.next = begin;
+            block.end = begin + id_generator::block_size;
+        }
+        return id_t(block.next++, zero<int64_t>());
+    }
 }
 
 namespace std
@@ -0,0 +1,169 @@
+#ifndef DAS_INLINE_VECTOR_HPP
+#define DAS_INLINE_VECTOR_HPP
+
+#include <cstddef>
+#include <new>
+#include <memory>
+#include <utility>
+#include <iterator>
+#include <algorithm>
+#include <type_traits>
+#include <initializer_list>
+
+#include "prelude.hpp"
+
+namespace das
+{
+    // A vector that stores up to N elements inline, only going to the heap once it grows past
+    // them. It offers the parts of the std::vector interface that das uses so it can stand in for
+    // one where the number of elements is almost always small.
+    template<typename T, std::size_t N>
+    class inline_vector
+    {
+    private:
+
+        std::size_t count;
+        std::size_t capacity;
+        T* heap_opt;
+        alignas(T) unsigned char storage[sizeof(T) * N];
+
+        T* get_data() { return heap_opt ? heap_opt : reinterpret_cast<T*>(storage); }
+        const T* get_data() const { return heap_opt ? heap_opt : reinterpret_cast<const T*>(storage); }
+
+        void grow(std::size_t capacity_min)
+        {
+            // build the elements anew before destroying the old ones, moving them only where that
+            // can't throw, so that a throw leaves the vector as it was
+            VAL capacity_grown = std::max(capacity_min, capacity * 2);
+            VAR* heap = static_cast<T*>(::operator new(capacity_grown * sizeof(T)));
+            VAR* data = get_data();
+            std::size_t constructed = 0;
+            try
+            {
+                for (; constructed < count; ++constructed) ::new (heap + constructed) T(std::move_if_noexcept(data[constructed]));
+            }
+            catch (...)
+            {
+                for (std::size_t i = 0; i < constructed; ++i) heap[i].~T();
+                ::operator delete(heap);
+                throw;
+            }
+            for (std::size_t i = 0; i < count; ++i) data[i].~T();
+            if (heap_opt) ::operator delete(heap_opt);
+            heap_opt = heap;
+            capacity = capacity_grown;
+        }
+
+        void clear()
+        {
+            VAR* data = get_data();
+            for (std::size_t i = 0; i < count; ++i) data[i].~T();
+            count = 0;
+        }
+
+        void release()
+        {
+            clear();
+            if (heap_opt) ::operator delete(heap_opt);
+            heap_opt = nullptr;
+            capacity = N;
+        }
+
+    public:
+
+        using value_type = T;
+        using size_type = std::size_t;
+        using iterator = T*;
+        using const_iterator = const T*;
+
+        inline_vector() : count(), capacity(N), heap_opt() { }
+
+        template<typename It>
+        inline_vector(It begin, It end) : inline_vector()
+        {
+            for (VAR it = begin; it != end; ++it) push_back(*it);
+        }
+
+        inline_vector(std::initializer_list<T> elements) : inline_vector(std::begin(elements), std::end(elements)) { }
+
+        inline_vector(const inline_vector& that) : inline_vector(std::begin(that), std::end(that)) { }
+
+        inline_vector(inline_vector&& that_mvb) noexcept(std::is_nothrow_move_constructible<T>::value) : inline_vector()
+        {
+            *this = std::move(that_mvb);
+        }
+
+        inline_vector& operator=(const inline_vector& that)
+        {
+            if (this == &that) return *this;
+            clear();
+            reserve(that.count);
+            for (VAL& element : that) push_back(element);
+            return *this;
+        }
+
+        inline_vector& operator=(inline_vector&& that_mvb) noexcept(std::is_nothrow_move_constructible<T>::value)
+        {
+            if (this == &that_mvb) return *this;
+            release();
+            if (that_mvb.heap_opt)
+            {
+                // steal the heap elements outright
+                heap_opt = that_mvb.heap_opt;
+                capacity = that_mvb.capacity;
+                count = that_mvb.count;
+                that_mvb.heap_opt = nullptr;
+                that_mvb.capacity = N;
+                that_mvb.count = 0;
+            }
+            else
+            {
+                for (VAR& element : that_mvb) push_back(std::move(element));
+                that_mvb.clear();
+            }
+            return *this;
+        }
+
+        ~inline_vector()
+        {
+            release();
+        }
+
+        void reserve(std::size_t capacity_min)
+        {
+            if (capacity_min > capacity) grow(capacity_min);
+        }
+
+        void push_back(const T& element)
+        {
+            if (count == capacity) { T element_copy(element); grow(count + 1); ::new (get_data() + count) T(std::move(element_copy)); }
+            else ::new (get_data() + count) T(element);
+            ++count;
+        }
+
+        void push_back(T&& element_mvb)
+        {
+            if (count == capacity) { T element_moved(std::move(element_mvb)); grow(count + 1); ::new (get_data() + count) T(std::move(element_moved)); }
+            else ::new (get_data() + count) T(std::move(element_mvb));
+            ++count;
+        }
+
+        std::size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+        T& operator[](std::size_t index) { return get_data()[index]; }
+        const T& operator[](std::size_t index) const { return get_data()[index]; }
+        T* begin() { return get_data(); }
+        T* end() { return get_data() + count; }
+        const T* begin() const { return get_data(); }
+        const T* end() const { return get_data() + count; }
+        const T* cbegin() const { return get_data(); }
+        const T* cend() const { return get_data() + count; }
+
+        bool operator==(const inline_vector& that) const
+        {
+            return count == that.count && std::equal(begin(), end(), that.begin());
+        }
+    };
+}
+
+#endif
@@ -5,14 +5,161 @@
 #include <string>
 #include <numeric>
 #include <vector>
+#ifdef DAS_INTERNED_NAMES
+#include <cstdint>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <unordered_map>
+#endif
 
 #include "prelude.hpp"
 #include "hash.hpp"
 
 namespace das
 {
+    // Get the hash of a name's string. It is constexpr so that the names of address literals can
+    // be hashed at compile time. Interned names are hashed by their index instead.
+    constexpr std::size_t get_name_hash(const char* name_str, std::size_t size)
+    {
+        return static_cast<std::size_t>(get_hash_fnv1a(name_str, size));
+    }
+
+#ifdef DAS_INTERNED_NAMES
+    // The global table of interned name strings, used when DAS_INTERNED_NAMES is defined.
+    //
+    // The table is append-only. Each string is interned just once, and is indexed in blocks that
+    // never move once allocated, so the string of an interned name is read without locking. Only
+    // interning takes a lock, which is shared unless the string is new to the table.
+    class name_table
+    {
+    private:
+
+        static constexpr std::size_t block_size = 4096;
+        static constexpr std::size_t block_count = 16384;
+
+        std::shared_timed_mutex mutex;
+        std::unordered_map<std::string, std::uint32_t> indices;
+        std::array<std::atomic<const std::string**>, block_count> blocks;
+        std::uint32_t size;
+
+    protected:
+
+        friend std::uint32_t intern_name(name_table& table, const std::string& name_str);
+        friend const std::string& get_interned_name_str(const name_table& table, std::uint32_t index);
+
+    public:
+
+        CONSTRAINT(name_table);
+
+        name_table(const name_table&) = delete;
+        name_table(name_table&&) = delete;
+        name_table& operator=(const name_table&) = delete;
+        name_table& operator=(name_table&&) = delete;
+
+        name_table() : mutex(), indices(), blocks(), size()
+        {
+            for (VAR& block : blocks) block.store(nullptr, std::memory_order_relaxed);
+        }
+
+        ~name_table()
+        {
+            for (VAR& block : blocks) delete[] block.load(std::memory_order_relaxed);
+        }
+    };
+
+    // Get the index of a string in a name table, interning it if it is new to the table.
+    inline std::uint32_t intern_name(name_table& table, const std::string& name_str)
+    {
+        {
+            std::shared_lock<std::shared_timed_mutex> lock(table.mutex);
+            VAL index_found = table.indices.find(name_str);
+            if (index_found != std::end(table.indices)) return index_found->second;
+        }
+        std::unique_lock<std::shared_timed_mutex> lock(table.mutex);
+        VAL index_emplaced = table.indices.emplace(name_str, table.size);
+        if (!index_emplaced.second) return index_emplaced.first->second;
+        VAL index = table.size;
+        VAL block_index = index / name_table::block_size;
+        if (block_index == name_table::block_count) throw std::out_of_range("das::name_table overflowed.");
+        VAR* block = table.blocks[block_index].load(std::memory_order_relaxed);
+        if (!block)
+        {
+            block = new const std::string*[name_table::block_size];
+            table.blocks[block_index].store(block, std::memory_order_release);
+        }
+        // the map's keys never move, so the block can point at them directly
+        block[index % name_table::block_size] = &index_emplaced.first->first;
+        ++table.size;
+        return index;
+    }
+
+    // Get the string interned at an index of a name table.
+    inline const std::string& get_interned_name_str(const name_table& table, std::uint32_t index)
+    {
+        VAL* block = table.blocks[index / name_table::block_size].load(std::memory_order_acquire);
+        return *block[index % name_table::block_size];
+    }
+
+    // Get the global name table, interning the empty string first so that a default name is
+    // empty. The table is never destroyed, so names stay readable during static destruction.
+    inline name_table& get_name_table()
+    {
+        static name_table& table = *[]()
+        {
+            VAR* table = new name_table();
+            intern_name(*table, std::string());
+            return table;
+        }();
+        return table;
+    }
+
+    // A name value implemented as a data abstraction. Being interned, it is just the index of its
+    // string in the global name table, so it is compared and hashed as an integer.
+    class name_t
+    {
+    private:
+
+        std::uint32_t index;
+
+    protected:
+
+        friend const std::string& get_name_str(const name_t& name);
+
+    public:
+
+        name_t() : index() { }
+        name_t(const name_t&) = default;
+        name_t(name_t&&) = default;
+        name_t& operator=(const name_t&) = default;
+        name_t& operator=(name_t&&) = default;
+
+        name_t(const char* name_str) : name_t(std::string(name_str)) { }
+        name_t(const std::string& name_str) : index(intern_name(get_name_table(), name_str)) { }
+        explicit name_t(std::string&& name_str_mvb) : index(intern_name(get_name_table(), name_str_mvb)) { }
+        explicit operator std::size_t() const { return static_cast<std::size_t>(index * 0x9E3779B97F4A7C15ull); } // spread the indices' bits
+        bool operator==(const name_t& that) const { return index == that.index; }
+    };
+
+    // Get the string of which a name is composed.
+    inline const std::string& get_name_str(const name_t& name)
+    {
+        return get_interned_name_str(get_name_table(), name.index);
+    }
+
+    // Make a name from a string whose hash is already known. An interned name must still be
+    // looked up in the name table, so the hash is unused.
+    inline name_t make_name_hashed(const char* name_str, std::size_t size, std::size_t)
+    {
+        return name_t(std::string(name_str, size));
+    }
+#else
     // A name value implemented as a data abstraction. Its hash is cached for true constant-time
-    // lookup.
+    // lookup. Defining DAS_INTERNED_NAMES instead interns names into a global table, making them
+    // 4-byte handles with integer equality.
     class name_t
     {
     private:
@@ -20,9 +167,12 @@ namespace das
         std::size_t hash_code;
         std::string name_str;
 
+        name_t(std::string&& name_str_mvb, std::size_t hash_code) : hash_code(hash_code), name_str(std::move(name_str_mvb)) { }
+
     protected:
 
         friend const std::string& get_name_str(const name_t& name);
+        friend name_t make_name_hashed(const char* name_str, std::size_t size, std::size_t hash_code);
 
     public:
 
@@ -33,8 +183,8 @@ namespace das
         name_t& operator=(name_t&&) = default;
 
         name_t(const char* name_str) : name_t(std::string(name_str)) { }
-        name_t(const std::string& name_str) : hash_code(get_hash(name_str)), name_str(name_str) { }
-        explicit name_t(std::string&& name_str_mvb) : hash_code(get_hash(name_str_mvb)), name_str(std::move(name_str_mvb)) { }
+        name_t(const std::string& name_str) : hash_code(get_name_hash(name_str.data(), name_str.size())), name_str(name_str) { }
+        explicit name_t(std::string&& name_str_mvb) : hash_code(get_name_hash(name_str_mvb.data(), name_str_mvb.size())), name_str(std::move(name_str_mvb)) { }
         explicit operator std::size_t() const { return hash_code; }
         bool operator==(const name_t& that) const { return name_str == that.name_str; }
     };
@@ -44,10 +194,19 @@ namespace das
     {
         return name.name_str;
     }
+
+    // Make a name whose hash, as given by get_name_hash, is already known.
+    inline name_t make_name_hashed(const char* name_str, std::size_t size, std::size_t hash_code)
+    {
+        return name_t(std::string(name_str, size), hash_code);
+    }
+#endif
 }
 
 // We need to allow operator""n in the global namespace...
+#ifdef _MSC_VER
 #pragma warning(disable: 4455)
+#endif
 
 // Name suffix operator.
 inline das::name_t operator ""n(const char *str, std::size_t len)
@@ -11,13 +11,19 @@
 #include <cstddef>
 
 // Variable shadowing is a good thing when doing functional-style programming.
+#ifdef _MSC_VER
 #pragma warning(disable: 4456)
+#endif
 
 // We need to allow operator""z in the global namespace...
+#ifdef _MSC_VER
 #pragma warning(disable: 4455)
+#endif
 
 // Use of unconditional branches is a common technique in C++ metaprogramming.
+#ifdef _MSC_VER
 #pragma warning(disable: 4127)
+#endif
 
 // Short-hand for immutable auto.
 #define VAL auto const
@@ -72,7 +78,9 @@ constexpr std::size_t operator""z(unsigned long long n)
 }
 
 // Restore our warning, of course.
+#ifdef _MSC_VER
 #pragma warning(default: 4455)
+#endif
 
 namespace das
 {
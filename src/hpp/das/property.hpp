@@ -62,23 +62,29 @@ namespace das
         return property = value;
     }
 
-    // TODO: promote to full type that is inspectable
+    // A map of heterogeneous properties, each its own heap object. See property_store.hpp for a
+    // flat alternative.
     using property_map = std::unordered_map<name_t, std::unique_ptr<castable>>;
 
+    // Get a property of a map, throwing if there is none of the name or it is of another type.
     template<typename T>
-    property<T> get_property(const property_map& properties, const name_t& name)
+    const property<T>& get_property(const property_map& properties, const name_t& name)
     {
-        const property_map::iterator property_opt = properties.find(name);
-        if (property_opt) return *property_opt;
-        throw std::logic_error("No such property.");
+        VAL property_opt = properties.find(name);
+        if (property_opt == std::end(properties)) throw std::logic_error("No such property.");
+        VAL* property_t_opt = try_cast_const<property<T>>(*property_opt->second);
+        if (!property_t_opt) throw std::logic_error("Property is of another type.");
+        return *property_t_opt;
     }
 
     template<typename T>
     property<T>& get_property(property_map& properties, const name_t& name)
     {
-        const property_map::iterator property_opt = properties.find(name);
-        if (property_opt) return *property_opt;
-        throw std::logic_error("No such property.");
+        VAL property_opt = properties.find(name);
+        if (property_opt == std::end(properties)) throw std::logic_error("No such property.");
+        VAR* property_t_opt = try_cast<property<T>>(*property_opt->second);
+        if (!property_t_opt) throw std::logic_error("Property is of another type.");
+        return *property_t_opt;
     }
 }
 
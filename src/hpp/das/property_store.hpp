@@ -0,0 +1,513 @@
+#ifndef DAS_PROPERTY_STORE_HPP
+#define DAS_PROPERTY_STORE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <memory>
+#include <utility>
+#include <algorithm>
+#include <vector>
+#include <stdexcept>
+
+#include "prelude.hpp"
+#include "name.hpp"
+#include "castable.hpp"
+#include "addressable.hpp"
+#include "address.hpp"
+
+namespace das
+{
+    class property_store;
+    class property_changes;
+
+    template<typename T>
+    struct property_ref;
+
+    // A property value as stored in a column. Wrapping it keeps a column of bools from being a
+    // std::vector<bool>, whose elements can't be referenced.
+    template<typename T>
+    struct property_cell
+    {
+        T value;
+    };
+
+    // The part of a property store's column that is the same for every type, being the names of
+    // its properties and their dirty bits, along with the addresses their changes are published
+    // to while their store is observed.
+    class property_column_base : public castable
+    {
+    private:
+
+        property_store* store;
+        std::uint32_t column_index;
+        std::vector<name_t> names;
+        std::vector<unsigned char> changed;
+        std::vector<address> change_addresses;
+
+    protected:
+
+        ENABLE_CAST(property_column_base, castable);
+
+        template<typename T>
+        friend property_ref<T> set_property(property_store& store, const name_t& name, const T& value);
+
+        friend void mark_property_changed(property_column_base& column, std::size_t row);
+        friend void observe_property_changes(property_store& store, property_changes& changes, const address& address, const std::shared_ptr<addressable>& publisher);
+        friend void unobserve_property_changes(property_store& store);
+
+        template<typename F>
+        friend std::size_t flush_property_changes(property_changes& changes, const F& publish);
+
+    public:
+
+        CONSTRAINT(property_column_base);
+
+        property_column_base(const property_column_base&) = delete;
+        property_column_base(property_column_base&&) = delete;
+        property_column_base& operator=(const property_column_base&) = delete;
+        property_column_base& operator=(property_column_base&&) = delete;
+
+        property_column_base(property_store& store, std::uint32_t column_index) :
+            store(&store),
+            column_index(column_index),
+            names(),
+            changed(),
+            change_addresses()
+        { }
+    };
+
+    // The values of all the properties of a single type in a property store, stored contiguously.
+    template<typename T>
+    class property_column : public property_column_base
+    {
+    private:
+
+        std::vector<property_cell<T>> values;
+
+    protected:
+
+        ENABLE_CAST(property_column<T>, property_column_base);
+
+        template<typename A>
+        friend std::vector<property_cell<A>>& get_column_values(property_column<A>& column);
+
+        template<typename A>
+        friend const std::vector<property_cell<A>>& get_column_values(const property_column<A>& column);
+
+    public:
+
+        CONSTRAINT(property_column);
+
+        property_column(property_store& store, std::uint32_t column_index) : property_column_base(store, column_index), values() { }
+    };
+
+    template<typename T>
+    std::vector<property_cell<T>>& get_column_values(property_column<T>& column)
+    {
+        return column.values;
+    }
+
+    template<typename T>
+    const std::vector<property_cell<T>>& get_column_values(const property_column<T>& column)
+    {
+        return column.values;
+    }
+
+    // A typed reference to a property of a store, through which its value is accessed without
+    // looking up its name or checking its type again. It stays valid as long as its store does.
+    template<typename T>
+    struct property_ref
+    {
+        CONSTRAINT(property_ref);
+
+        property_column<T>* column;
+        std::size_t row;
+    };
+
+    // A slot of a property store's name table, being empty when its column index is the greatest
+    // uint32_t.
+    struct property_slot
+    {
+        CONSTRAINT(property_slot);
+
+        name_t name;
+        std::uint32_t column_index;
+        std::uint32_t row;
+    };
+
+    // The position of a changed property in its store.
+    struct property_change_row
+    {
+        CONSTRAINT(property_change_row);
+
+        std::uint32_t column_index;
+        std::uint32_t row;
+    };
+
+    // The event published for a changed property by flush_property_changes. It carries the
+    // property's current value by reference rather than by copy, so one event type serves
+    // properties of every type. See get_changed_value.
+    struct property_change
+    {
+        CONSTRAINT(property_change);
+
+        name_t name;
+        const property_column_base* column;
+        std::size_t row;
+    };
+
+    // A flat store of heterogeneous properties.
+    //
+    // Names are kept in an open-addressing table with linear probing, which with interned names
+    // (see DAS_INTERNED_NAMES) compares and hashes them as integers. Values are kept inline in one
+    // contiguous column per type, so a property costs no allocation of its own. A name lookup
+    // checks the property's type once per lookup, and a property_ref skips even that. Adding a
+    // property may move the values of its type, so references to values must not be held across
+    // adds, though property_refs may.
+    //
+    // A store may be observed with observe_property_changes, after which every write to one of its
+    // properties sets the property's dirty bit, and the first write since the last flush also
+    // appends the property to the store's dirty list. A flush then publishes one property_change
+    // event per property in the list, however many times it was written, without looking at the
+    // properties that were not.
+    class property_store
+    {
+    private:
+
+        std::vector<property_slot> slots;
+        std::size_t count;
+        std::vector<std::pair<castable_type_key, std::unique_ptr<property_column_base>>> columns;
+        property_changes* changes_opt;
+        address publish_address;
+        std::shared_ptr<addressable> publisher;
+        std::vector<property_change_row> properties_changed;
+
+    protected:
+
+        friend const property_slot* try_find_property_slot(const property_store& store, const name_t& name);
+        friend void grow_property_slots(property_store& store);
+
+        template<typename T>
+        friend std::pair<property_column<T>*, std::uint32_t> get_or_add_property_column(property_store& store);
+
+        template<typename T>
+        friend property_ref<T> try_get_property_ref(property_store& store, const name_t& name);
+
+        template<typename T>
+        friend property_ref<T> set_property(property_store& store, const name_t& name, const T& value);
+
+        friend std::size_t get_property_count(const property_store& store);
+        friend void mark_property_changed(property_column_base& column, std::size_t row);
+        friend void observe_property_changes(property_store& store, property_changes& changes, const address& address, const std::shared_ptr<addressable>& publisher);
+        friend void unobserve_property_changes(property_store& store);
+
+        template<typename F>
+        friend std::size_t flush_property_changes(property_changes& changes, const F& publish);
+
+    public:
+
+        CONSTRAINT(property_store);
+
+        // columns point back to their store, so a store stays put
+        property_store(const property_store&) = delete;
+        property_store(property_store&&) = delete;
+        property_store& operator=(const property_store&) = delete;
+        property_store& operator=(property_store&&) = delete;
+
+        property_store() :
+            slots(),
+            count(),
+            columns(),
+            changes_opt(),
+            publish_address(),
+            publisher(),
+            properties_changed()
+        { }
+
+        ~property_store()
+        {
+            unobserve_property_changes(*this);
+        }
+    };
+
+    // The property stores of a program that have had properties changed since they were last
+    // flushed, each listed once.
+    class property_changes
+    {
+    private:
+
+        std::vector<property_store*> stores_changed;
+        std::vector<std::vector<property_store*>*> stores_flushing;
+
+    protected:
+
+        friend void mark_property_changed(property_column_base& column, std::size_t row);
+        friend void unobserve_property_changes(property_store& store);
+
+        template<typename F>
+        friend std::size_t flush_property_changes(property_changes& changes, const F& publish);
+
+    public:
+
+        CONSTRAINT(property_changes);
+
+        property_changes() : stores_changed(), stores_flushing() { }
+        property_changes(const property_changes&) = delete;
+        property_changes(property_changes&&) = delete;
+        property_changes& operator=(const property_changes&) = delete;
+        property_changes& operator=(property_changes&&) = delete;
+    };
+
+    constexpr std::uint32_t property_slot_empty = std::numeric_limits<std::uint32_t>::max();
+
+    // Mark a property as changed if its store is observed, adding it to the store's dirty list
+    // unless it is already there.
+    inline void mark_property_changed(property_column_base& column, std::size_t row)
+    {
+        VAR& store = *column.store;
+        if (!store.changes_opt || column.changed[row]) return;
+        column.changed[row] = 1;
+        if (store.properties_changed.empty()) store.changes_opt->stores_changed.push_back(&store);
+        store.properties_changed.push_back(property_change_row{ column.column_index, static_cast<std::uint32_t>(row) });
+    }
+
+    template<typename T>
+    const T& get_value(const property_ref<T>& ref)
+    {
+        return get_column_values(*ref.column)[ref.row].value;
+    }
+
+    template<typename T>
+    T& set_value(const property_ref<T>& ref, const T& value)
+    {
+        VAR& cell = get_column_values(*ref.column)[ref.row];
+        cell.value = value;
+        mark_property_changed(*ref.column, ref.row);
+        return cell.value;
+    }
+
+    // Find the slot of a name in a store, or null if the store has no property of the name.
+    inline const property_slot* try_find_property_slot(const property_store& store, const name_t& name)
+    {
+        if (store.slots.empty()) return nullptr;
+        VAL mask = store.slots.size() - 1;
+        for (VAR index = get_hash(name) & mask;; index = (index + 1) & mask)
+        {
+            VAL& slot = store.slots[index];
+            if (slot.column_index == property_slot_empty) return nullptr;
+            if (slot.name == name) return &slot;
+        }
+    }
+
+    // Double a store's name table, or start it, keeping it at most half full.
+    inline void grow_property_slots(property_store& store)
+    {
+        std::vector<property_slot> slots(store.slots.empty() ? 16 : store.slots.size() * 2, property_slot{ name_t(std::string()), property_slot_empty, 0 });
+        VAL mask = slots.size() - 1;
+        for (VAR& slot : store.slots)
+        {
+            if (slot.column_index == property_slot_empty) continue;
+            VAR index = get_hash(slot.name) & mask;
+            while (slots[index].column_index != property_slot_empty) index = (index + 1) & mask;
+            slots[index] = std::move(slot);
+        }
+        store.slots = std::move(slots);
+    }
+
+    // Get the column of type T of a store and its index, adding it if there is none. Stores hold
+    // few types, so the columns are just searched.
+    template<typename T>
+    std::pair<property_column<T>*, std::uint32_t> get_or_add_property_column(property_store& store)
+    {
+        VAL key = get_castable_type_key<property_column<T>>();
+        for (std::size_t i = 0; i < store.columns.size(); ++i)
+            if (store.columns[i].first == key)
+                return std::make_pair(static_cast<property_column<T>*>(store.columns[i].second.get()), static_cast<std::uint32_t>(i));
+        VAL column_index = static_cast<std::uint32_t>(store.columns.size());
+        store.columns.emplace_back(key, std::make_unique<property_column<T>>(store, column_index));
+        return std::make_pair(static_cast<property_column<T>*>(store.columns.back().second.get()), column_index);
+    }
+
+    // Try to get a typed reference to a property of a store, or a reference with a null column if
+    // there is no such property. Throws if the property is of another type.
+    template<typename T>
+    property_ref<T> try_get_property_ref(property_store& store, const name_t& name)
+    {
+        VAL* slot_opt = try_find_property_slot(store, name);
+        if (!slot_opt) return property_ref<T>{ nullptr, 0 };
+        VAL& column = store.columns[slot_opt->column_index];
+        if (column.first != get_castable_type_key<property_column<T>>()) throw std::logic_error("Property is of another type.");
+        return property_ref<T>{ static_cast<property_column<T>*>(column.second.get()), slot_opt->row };
+    }
+
+    // Get a typed reference to a property of a store, throwing if there is no such property or it
+    // is of another type.
+    template<typename T>
+    property_ref<T> get_property_ref(property_store& store, const name_t& name)
+    {
+        VAL ref = try_get_property_ref<T>(store, name);
+        if (!ref.column) throw std::logic_error("No such property.");
+        return ref;
+    }
+
+    // Set a property of a store, adding it if there is none of the name, and throwing if there is
+    // one of another type. Adding a property counts as changing it.
+    template<typename T>
+    property_ref<T> set_property(property_store& store, const name_t& name, const T& value)
+    {
+        VAL ref = try_get_property_ref<T>(store, name);
+        if (ref.column)
+        {
+            set_value(ref, value);
+            return ref;
+        }
+        if ((store.count + 1) * 2 > store.slots.size()) grow_property_slots(store);
+        VAL column = get_or_add_property_column<T>(store);
+        VAR& values = get_column_values(*column.first);
+        values.push_back(property_cell<T>{ value });
+        column.first->names.push_back(name);
+        column.first->changed.push_back(0);
+        if (store.changes_opt) column.first->change_addresses.push_back(store.publish_address + address(name));
+        VAL row = values.size() - 1;
+        VAL mask = store.slots.size() - 1;
+        VAR index = get_hash(name) & mask;
+        while (store.slots[index].column_index != property_slot_empty) index = (index + 1) & mask;
+        store.slots[index] = property_slot{ name, column.second, static_cast<std::uint32_t>(row) };
+        ++store.count;
+        mark_property_changed(*column.first, row);
+        return property_ref<T>{ column.first, row };
+    }
+
+    // Get the value of a property of a store, throwing if there is no such property or it is of
+    // another type.
+    template<typename T>
+    const T& get_property_value(property_store& store, const name_t& name)
+    {
+        return get_value(get_property_ref<T>(store, name));
+    }
+
+    inline std::size_t get_property_count(const property_store& store)
+    {
+        return store.count;
+    }
+
+    // Stop tracking the changes of a store, dropping those not yet flushed.
+    inline void unobserve_property_changes(property_store& store)
+    {
+        if (!store.changes_opt) return;
+        if (!store.properties_changed.empty())
+        {
+            // null rather than erase the store's entry, as a flush may be walking the list
+            VAR& changes = *store.changes_opt;
+            std::replace(changes.stores_changed.begin(), changes.stores_changed.end(), &store, static_cast<property_store*>(nullptr));
+            for (VAR* stores : changes.stores_flushing) std::replace(stores->begin(), stores->end(), &store, static_cast<property_store*>(nullptr));
+            for (VAL& change_row : store.properties_changed) store.columns[change_row.column_index].second->changed[change_row.row] = 0;
+            store.properties_changed.clear();
+        }
+        for (VAL& column : store.columns) column.second->change_addresses.clear();
+        store.changes_opt = nullptr;
+        store.publish_address = address();
+        store.publisher.reset();
+    }
+
+    // Track the changes of a store in a change list, such that each flush of the list publishes
+    // one property_change per changed property at the given address with the property's name
+    // appended. The address of each property is built once here, or when the property is added,
+    // rather than per change. A store must be unobserved or destroyed before its change list.
+    inline void observe_property_changes(property_store& store, property_changes& changes, const address& address, const std::shared_ptr<addressable>& publisher)
+    {
+        unobserve_property_changes(store);
+        store.changes_opt = &changes;
+        store.publish_address = address;
+        store.publisher = publisher;
+        for (VAL& column : store.columns)
+            for (VAL& name : column.second->names)
+                column.second->change_addresses.push_back(address + das::address(name));
+    }
+
+    // Publish the changes in a change list through the given function, clearing the dirty bits
+    // of the changed properties first so that writes during publishing are flushed next time.
+    // Returns the number of changes published. A store unobserved during the flush has its
+    // remaining changes dropped, and should publishing throw, the changes not yet published are
+    // kept for the next flush. A store must not be destroyed while its own changes are being
+    // published.
+    template<typename F>
+    std::size_t flush_property_changes(property_changes& changes, const F& publish)
+    {
+        // take the list of changed stores, so that stores changed during the flush, including by
+        // a nested flush, are listed afresh and left for the next flush
+        std::vector<property_store*> stores{};
+        std::swap(stores, changes.stores_changed);
+        changes.stores_flushing.push_back(&stores);
+        std::vector<property_change_row> change_rows{};
+        property_store* store_publishing_opt = nullptr;
+        std::size_t row_index = 0;
+        std::size_t change_count = 0;
+        try
+        {
+            for (VAR*& store_opt : stores)
+            {
+                if (!store_opt) continue;
+                VAR& store = *store_opt;
+                store_opt = nullptr;
+                change_rows.clear();
+                std::swap(change_rows, store.properties_changed);
+                for (VAL& change_row : change_rows) store.columns[change_row.column_index].second->changed[change_row.row] = 0;
+                store_publishing_opt = &store;
+                for (row_index = 0; row_index < change_rows.size() && store.changes_opt == &changes; ++row_index)
+                {
+                    // copy the address and publisher, as handlers may add properties to the store
+                    // or unobserve it while they are in use
+                    VAL& change_row = change_rows[row_index];
+                    VAL& column = *store.columns[change_row.column_index].second;
+                    VAL change_address = column.change_addresses[change_row.row];
+                    VAL publisher = store.publisher;
+                    publish(property_change{ column.names[change_row.row], &column, change_row.row }, change_address, publisher);
+                    ++change_count;
+                }
+                store_publishing_opt = nullptr;
+            }
+        }
+        catch (...)
+        {
+            // relist the stores not yet flushed, and mark again the changes after the one that
+            // threw
+            changes.stores_flushing.pop_back();
+            for (VAR* store_opt : stores) if (store_opt) changes.stores_changed.push_back(store_opt);
+            if (store_publishing_opt)
+                for (std::size_t i = row_index + 1; i < change_rows.size(); ++i)
+                    mark_property_changed(*store_publishing_opt->columns[change_rows[i].column_index].second, change_rows[i].row);
+            throw;
+        }
+        changes.stores_flushing.pop_back();
+
+        // keep the list's capacity when nothing was changed during the flush
+        if (changes.stores_changed.empty())
+        {
+            stores.clear();
+            std::swap(stores, changes.stores_changed);
+        }
+        return change_count;
+    }
+
+    // Try to get the current value of a changed property, or null if it is not a T.
+    template<typename T>
+    const T* try_get_changed_value(const property_change& change)
+    {
+        VAL* column_opt = try_cast_const<property_column<T>>(*change.column);
+        return column_opt ? &get_column_values(*column_opt)[change.row].value : nullptr;
+    }
+
+    // Get the current value of a changed property, throwing if it is not a T.
+    template<typename T>
+    const T& get_changed_value(const property_change& change)
+    {
+        VAL* value_opt = try_get_changed_value<T>(change);
+        if (!value_opt) throw std::logic_error("Property is of another type.");
+        return *value_opt;
+    }
+}
+
+#endif
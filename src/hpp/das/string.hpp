@@ -8,7 +8,9 @@
 #include "prelude.hpp"
 
 // We need to allow operator""s in the global namespace...
+#ifdef _MSC_VER
 #pragma warning(disable: 4455)
+#endif
 
 // This should have been in the global namespace...
 inline std::string operator ""s(const char *str, std::size_t len)
@@ -17,7 +19,9 @@ inline std::string operator ""s(const char *str, std::size_t len)
 }
 
 // Restore our warning, of course.
+#ifdef _MSC_VER
 #pragma warning(default: 4455)
+#endif
 
 namespace das
 {
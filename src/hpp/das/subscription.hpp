@@ -12,27 +12,31 @@
 #include "castable.hpp"
 #include "addressable.hpp"
 #include "address.hpp"
+#include "address_trie.hpp"
 #include "event.hpp"
 
 namespace das
 {
+    // A handler of the events of a subscription. Handlers are given a view of each event so that
+    // nothing is copied per delivery, though a handler written against event<T> still works, paying
+    // for a copy of the event on each delivery.
     template<typename T, typename P>
-    using handler = std::function<bool(const event<T>&, P&)>;
+    using handler = std::function<bool(const event_view<T>&, P&)>;
 
     template<typename T, typename P>
     class subscription_detail : public castable
     {
     private:
 
-        const handler<T, P> handler;
+        const das::handler<T, P> handler;
 
     protected:
 
         using subscription_detail_T_P = subscription_detail<T, P>;
         ENABLE_CAST(subscription_detail_T_P, castable);
 
-        template<typename T, typename P>
-        friend bool publish_subscription_detail(const subscription_detail<T, P>& subscription_detail, const event<T>& event, P& program);
+        template<typename U, typename Q>
+        friend bool publish_subscription_detail(const subscription_detail<U, Q>& subscription_detail, const event_view<U>& event, Q& program);
 
     public:
 
@@ -46,7 +50,7 @@ namespace das
     };
 
     template<typename T, typename P>
-    bool publish_subscription_detail(const subscription_detail<T, P>& subscription_detail, const event<T>& event, P& program)
+    bool publish_subscription_detail(const subscription_detail<T, P>& subscription_detail, const event_view<T>& event, P& program)
     {
         return subscription_detail.handler(event, program);
     }
@@ -55,14 +59,19 @@ namespace das
     {
     protected:
 
+        template<typename T, typename P>
+        friend bool publish_subscription(const subscription& subscription, const T& event_data, const address& event_address, const std::shared_ptr<addressable>& publisher, P& program, bool& handled);
+
         template<typename T, typename P>
         friend bool publish_subscription(const subscription& subscription, const T& event_data, const address& event_address, const std::shared_ptr<addressable>& publisher, P& program);
 
     public:
 
         const id_t id;
+        const int priority;
         const std::weak_ptr<addressable> subscriber_opt;
         const std::unique_ptr<castable> subscription_detail;
+        bool unsubscribed;
 
         subscription() = delete;
         subscription(const subscription&) = delete;
@@ -72,32 +81,221 @@ namespace das
 
         subscription(
             id_t id,
+            int priority,
             std::shared_ptr<addressable> subscriber,
             std::unique_ptr<castable> subscription_detail) :
             id(id),
+            priority(priority),
             subscriber_opt(subscriber),
-            subscription_detail(subscription_detail.release()) { }
+            subscription_detail(subscription_detail.release()),
+            unsubscribed(false) { }
     };
 
+    // Publish an event to a subscription.
+    //
+    // The subscription must have been made for events of type T, which is guaranteed for every
+    // subscription found in a channel of T. Thus its detail is down cast statically rather than
+    // checked with try_cast on each delivery.
+    //
+    // Sets whether the subscription's handler was called, which it is not when the subscription
+    // was unsubscribed or its subscriber has died.
     template<typename T, typename P>
-    bool publish_subscription(const subscription& subscription, const T& event_data, const address& event_address, const std::shared_ptr<addressable>& publisher, P& program)
+    bool publish_subscription(const subscription& subscription, const T& event_data, const address& event_address, const std::shared_ptr<addressable>& publisher, P& program, bool& handled)
     {
-        if (!subscription.subscriber_opt.expired())
+        handled = false;
+        if (subscription.unsubscribed) return true;
+        VAL& subscriber = subscription.subscriber_opt.lock();
+        if (subscriber)
         {
-            VAL& subscriber = subscription.subscriber_opt.lock();
-            VAL& event = das::event<T>(event_data, event_address, subscriber, publisher);
-            VAL& subscription_detail_opt = try_cast_const<subscription_detail<T, P>>(*subscription.subscription_detail);
-            if (subscription_detail_opt) return publish_subscription_detail(**subscription_detail_opt, event, program);
-            return true;
+            VAL event = das::event_view<T>(event_data, event_address, subscriber, publisher);
+            VAL& subscription_detail = static_cast<const das::subscription_detail<T, P>&>(*subscription.subscription_detail);
+            handled = true;
+            return publish_subscription_detail(subscription_detail, event, program);
         }
         return true;
     }
 
+    template<typename T, typename P>
+    bool publish_subscription(const subscription& subscription, const T& event_data, const address& event_address, const std::shared_ptr<addressable>& publisher, P& program)
+    {
+        bool handled = false;
+        return publish_subscription<T, P>(subscription, event_data, event_address, publisher, program, handled);
+    }
+
+    // A key that identifies a type of event. Unlike a std::type_index, it is just a pointer, so it
+    // is as cheap to hash and compare as anything can be.
+    using event_type_key = const void*;
+
+    // Get the key that identifies events of type T.
+    template<typename T>
+    event_type_key get_event_type_key()
+    {
+        static const char key = 0;
+        return &key;
+    }
+
+    // The key of a subscription channel. A channel carries only the events of a single type that
+    // are published to a single address, so every subscription in it has the same event type.
+    struct channel_key
+    {
+        das::address address;
+        event_type_key event_type;
+
+        channel_key() = default;
+        channel_key(const channel_key&) = default;
+        channel_key(channel_key&&) = default;
+        channel_key& operator=(const channel_key&) = default;
+        channel_key& operator=(channel_key&&) = default;
+
+        channel_key(const das::address& address, event_type_key event_type) : address(address), event_type(event_type) { }
+    };
+
     using subscription_list = std::vector<std::shared_ptr<subscription>>;
 
-    using subscriptions_map = std::unordered_map<address, std::unique_ptr<subscription_list>>;
+    // A snapshot of a channel's subscriptions. While any publish is in progress, a snapshot is
+    // never mutated but replaced wholesale whenever a subscription is added or removed, so a
+    // publish may borrow the snapshot it started with for as long as it likes without copying it.
+    using subscription_snapshot = std::unique_ptr<subscription_list>;
+
+    struct event_waiter_list;
+
+    // A one-shot waiter for the next event of a channel, such as a suspended coroutine. Waiters are
+    // linked intrusively into their channel's list, so waiting allocates nothing.
+    struct event_waiter
+    {
+        CONSTRAINT(event_waiter);
+
+        event_waiter_list* list_opt;
+        event_waiter* prev_opt;
+        event_waiter* next_opt;
+        const void* event_opt;
+        void(*resume)(void* context);
+        void* context;
+    };
+
+    // A list of event waiters, resumed in the order they were linked.
+    struct event_waiter_list
+    {
+        CONSTRAINT(event_waiter_list);
+
+        event_waiter* head_opt;
+        event_waiter* tail_opt;
+    };
+
+    inline void link_event_waiter(event_waiter_list& list, event_waiter& waiter)
+    {
+        waiter.list_opt = &list;
+        waiter.prev_opt = list.tail_opt;
+        waiter.next_opt = nullptr;
+        if (list.tail_opt) list.tail_opt->next_opt = &waiter;
+        else list.head_opt = &waiter;
+        list.tail_opt = &waiter;
+    }
 
-    using unsubscription_map = std::unordered_map<id_t, std::pair<address, std::weak_ptr<addressable>>>;
+    inline void unlink_event_waiter(event_waiter& waiter)
+    {
+        VAR& list = *waiter.list_opt;
+        if (waiter.prev_opt) waiter.prev_opt->next_opt = waiter.next_opt;
+        else list.head_opt = waiter.next_opt;
+        if (waiter.next_opt) waiter.next_opt->prev_opt = waiter.prev_opt;
+        else list.tail_opt = waiter.prev_opt;
+        waiter.list_opt = nullptr;
+        waiter.prev_opt = nullptr;
+        waiter.next_opt = nullptr;
+    }
+
+    // Forget the waiters of a list without resuming them, such as when their channel is destroyed.
+    inline void detach_event_waiters(event_waiter_list& list)
+    {
+        for (VAR* waiter = list.head_opt; waiter; waiter = waiter->next_opt) waiter->list_opt = nullptr;
+        list = event_waiter_list{ nullptr, nullptr };
+    }
+
+    // Resume each of the waiters of a list with a view of an event, unlinking each before it is
+    // resumed. Waiters that are linked while resuming wait for the next event rather than this one.
+    template<typename T>
+    void resume_event_waiters(event_waiter_list& waiters, const T& event_data, const address& event_address, const std::shared_ptr<addressable>& publisher)
+    {
+        if (!waiters.head_opt) return;
+        event_waiter_list resuming = waiters;
+        waiters = event_waiter_list{ nullptr, nullptr };
+        for (VAR* waiter = resuming.head_opt; waiter; waiter = waiter->next_opt) waiter->list_opt = &resuming;
+        const std::shared_ptr<addressable> subscriber{};
+        VAL event = event_view<T>(event_data, event_address, subscriber, publisher);
+        try
+        {
+            while (resuming.head_opt)
+            {
+                VAR& waiter = *resuming.head_opt;
+                unlink_event_waiter(waiter);
+                waiter.event_opt = &event;
+                waiter.resume(waiter.context);
+            }
+        }
+        catch (...)
+        {
+            // the waiters not yet resumed keep waiting
+            while (resuming.head_opt)
+            {
+                VAR& waiter = *resuming.head_opt;
+                unlink_event_waiter(waiter);
+                link_event_waiter(waiters, waiter);
+            }
+            throw;
+        }
+    }
+
+    // A channel of subscriptions. Subscriptions that are unsubscribed stay in the channel's
+    // snapshot until enough of them accumulate to be worth compacting away.
+    struct subscription_channel
+    {
+        CONSTRAINT(subscription_channel);
+
+        das::address address;
+        event_type_key event_type;
+        subscription_snapshot subscriptions;
+        std::size_t unsubscribed_count;
+        event_waiter_list waiters;
+    };
+
+    // The subscription channels at an address, one per type of event subscribed to there. As there
+    // are rarely more than a few, they are found by linear search on their event type key.
+    using subscription_channels = std::vector<std::unique_ptr<subscription_channel>>;
+
+    // Try to find the channel of the given event type.
+    inline subscription_channel* try_find_channel(const subscription_channels& channels, event_type_key event_type)
+    {
+        for (VAL& channel : channels)
+            if (channel->event_type == event_type)
+                return channel.get();
+        return nullptr;
+    }
+
+    // Find the channel of the given event type, adding an empty one if there is none.
+    inline subscription_channel& find_or_add_channel(subscription_channels& channels, const channel_key& channel_key)
+    {
+        for (VAL& channel : channels)
+            if (channel->event_type == channel_key.event_type)
+                return *channel;
+        channels.push_back(std::make_unique<subscription_channel>(subscription_channel{ channel_key.address, channel_key.event_type, std::make_unique<subscription_list>(), 0z, event_waiter_list{ nullptr, nullptr } }));
+        return *channels.back();
+    }
+
+    using subscriptions_map = std::unordered_map<address, subscription_channels>;
+
+    using subscription_trie = address_trie<subscription_channels>;
+
+    // A slot of a subscription slot map. A subscription's id is the index of its slot together with
+    // the slot's generation, which advances whenever the slot is freed so that stale ids never find
+    // a slot's later occupants.
+    struct subscription_slot
+    {
+        CONSTRAINT(subscription_slot);
+
+        int64_t generation;
+        subscription* subscription_opt;
+        subscription_channel* channel_opt;
+    };
 }
 
 #endif
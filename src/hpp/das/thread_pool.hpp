@@ -0,0 +1,251 @@
+#ifndef DAS_THREAD_POOL_HPP
+#define DAS_THREAD_POOL_HPP
+
+#include <cstddef>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <utility>
+#include <thread>
+#include <deque>
+#include <vector>
+#include <algorithm>
+
+#include "prelude.hpp"
+
+namespace das
+{
+    class task_group;
+    class thread_pool;
+
+    // A task of a thread pool, which calls a function over a range of indices. The function is
+    // borrowed rather than owned, so queuing a task never allocates.
+    struct pool_task
+    {
+        void(*run)(const void* fn, std::size_t begin, std::size_t end);
+        const void* fn;
+        std::size_t begin;
+        std::size_t end;
+        task_group* group;
+    };
+
+    // A batch of tasks whose completion is awaited together.
+    class task_group
+    {
+    private:
+
+        std::atomic<std::size_t> pending;
+        std::mutex exception_mutex;
+        std::exception_ptr exception_opt;
+
+    protected:
+
+        friend void run_pool_task(const pool_task& task);
+
+        template<typename F>
+        friend void parallel_for(thread_pool& pool, std::size_t count, const F& fn);
+
+    public:
+
+        CONSTRAINT(task_group);
+
+        task_group() : pending(0), exception_mutex(), exception_opt() { }
+        task_group(const task_group&) = delete;
+        task_group(task_group&&) = delete;
+        task_group& operator=(const task_group&) = delete;
+        task_group& operator=(task_group&&) = delete;
+    };
+
+    // Run a task, recording rather than propagating any exception it throws.
+    inline void run_pool_task(const pool_task& task)
+    {
+        try
+        {
+            task.run(task.fn, task.begin, task.end);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(task.group->exception_mutex);
+            if (!task.group->exception_opt) task.group->exception_opt = std::current_exception();
+        }
+        task.group->pending.fetch_sub(1);
+    }
+
+    // A queue of pool tasks belonging to one worker.
+    struct pool_task_queue
+    {
+        std::mutex mutex;
+        std::deque<pool_task> tasks;
+    };
+
+    // A work-stealing thread pool.
+    //
+    // Each worker has its own queue of tasks, taking work from the back of its own queue and
+    // stealing from the front of the others' when its own runs dry. A thread that waits on a
+    // task group helps run tasks until the group is done, so tasks may themselves fan out more
+    // tasks without the pool deadlocking.
+    class thread_pool
+    {
+    private:
+
+        std::vector<std::unique_ptr<pool_task_queue>> queues;
+        std::vector<std::thread> workers;
+        std::atomic<std::size_t> queued;
+        std::atomic<std::size_t> submissions;
+        std::mutex sleep_mutex;
+        std::condition_variable wake;
+        bool stopping;
+
+    protected:
+
+        friend bool try_pop_pool_task(thread_pool& pool, std::size_t queue_index, bool steal, pool_task& task);
+        friend bool try_run_pool_task(thread_pool& pool);
+        friend void push_pool_task(thread_pool& pool, const pool_task& task);
+        friend void run_pool_worker(thread_pool& pool, std::size_t worker_index);
+
+        template<typename F>
+        friend void parallel_for(thread_pool& pool, std::size_t count, const F& fn);
+
+    public:
+
+        CONSTRAINT(thread_pool);
+
+        explicit thread_pool(std::size_t worker_count = std::max(1u, std::thread::hardware_concurrency()));
+
+        thread_pool(const thread_pool&) = delete;
+        thread_pool(thread_pool&&) = delete;
+        thread_pool& operator=(const thread_pool&) = delete;
+        thread_pool& operator=(thread_pool&&) = delete;
+
+        ~thread_pool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(sleep_mutex);
+                stopping = true;
+            }
+            wake.notify_all();
+            for (VAR& worker : workers) worker.join();
+        }
+    };
+
+    // The worker of the pool that the calling thread belongs to, if any.
+    inline std::pair<thread_pool*, std::size_t>& get_current_pool_worker()
+    {
+        thread_local std::pair<thread_pool*, std::size_t> pool_worker(nullptr, 0z);
+        return pool_worker;
+    }
+
+    // Try to pop a task from one of a pool's queues, stealing from the front of the queue rather
+    // than popping from the back when the queue belongs to another worker.
+    inline bool try_pop_pool_task(thread_pool& pool, std::size_t queue_index, bool steal, pool_task& task)
+    {
+        VAR& queue = *pool.queues[queue_index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) return false;
+        if (steal)
+        {
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+        }
+        else
+        {
+            task = queue.tasks.back();
+            queue.tasks.pop_back();
+        }
+        pool.queued.fetch_sub(1);
+        return true;
+    }
+
+    // Try to run one of a pool's tasks on the calling thread, preferring the calling worker's own.
+    inline bool try_run_pool_task(thread_pool& pool)
+    {
+        VAL& pool_worker = get_current_pool_worker();
+        VAL own = pool_worker.first == &pool ? pool_worker.second : pool.queues.size();
+        pool_task task{};
+        if (own < pool.queues.size() && try_pop_pool_task(pool, own, false, task))
+        {
+            run_pool_task(task);
+            return true;
+        }
+        for (std::size_t i = 0; i < pool.queues.size(); ++i)
+        {
+            if (i != own && try_pop_pool_task(pool, i, true, task))
+            {
+                run_pool_task(task);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Push a task onto the calling worker's queue, or onto the queues in turn when not called
+    // from a worker.
+    inline void push_pool_task(thread_pool& pool, const pool_task& task)
+    {
+        VAL& pool_worker = get_current_pool_worker();
+        VAL queue_index = pool_worker.first == &pool ? pool_worker.second : pool.submissions.fetch_add(1) % pool.queues.size();
+        {
+            VAR& queue = *pool.queues[queue_index];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back(task);
+        }
+        {
+            std::lock_guard<std::mutex> lock(pool.sleep_mutex);
+            pool.queued.fetch_add(1);
+        }
+        pool.wake.notify_one();
+    }
+
+    // Run a pool's tasks on the calling thread as the given worker until the pool stops.
+    inline void run_pool_worker(thread_pool& pool, std::size_t worker_index)
+    {
+        get_current_pool_worker() = std::make_pair(&pool, worker_index);
+        for (;;)
+        {
+            if (try_run_pool_task(pool)) continue;
+            std::unique_lock<std::mutex> lock(pool.sleep_mutex);
+            pool.wake.wait(lock, [&pool]() { return pool.stopping || pool.queued.load() != 0; });
+            if (pool.stopping && pool.queued.load() == 0) return;
+        }
+    }
+
+    inline thread_pool::thread_pool(std::size_t worker_count) :
+        queues(),
+        workers(),
+        queued(0),
+        submissions(0),
+        sleep_mutex(),
+        wake(),
+        stopping(false)
+    {
+        for (std::size_t i = 0; i < worker_count; ++i) queues.push_back(std::make_unique<pool_task_queue>());
+        for (std::size_t i = 0; i < worker_count; ++i) workers.emplace_back([this, i]() { run_pool_worker(*this, i); });
+    }
+
+    // Call fn with each index in [0, count) across a pool, returning once every call has. The
+    // range is split into a few chunks per worker, and the calling thread helps run them. If any
+    // call throws, the first exception is rethrown once the others have finished.
+    template<typename F>
+    void parallel_for(thread_pool& pool, std::size_t count, const F& fn)
+    {
+        if (count == 0) return;
+        VAL chunk_count = std::min(count, pool.queues.size() * 4);
+        VAL chunk_size = (count + chunk_count - 1) / chunk_count;
+        task_group group{};
+        group.pending.store((count + chunk_size - 1) / chunk_size);
+        VAL run = [](const void* fn, std::size_t begin, std::size_t end)
+        {
+            for (VAR i = begin; i != end; ++i) (*static_cast<const F*>(fn))(i);
+        };
+        for (std::size_t begin = 0; begin < count; begin += chunk_size)
+            push_pool_task(pool, pool_task{ run, &fn, begin, std::min(begin + chunk_size, count), &group });
+        while (group.pending.load() != 0)
+            if (!try_run_pool_task(pool))
+                std::this_thread::yield();
+        if (group.exception_opt) std::rethrow_exception(group.exception_opt);
+    }
+}
+
+#endif